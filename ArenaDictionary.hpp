@@ -0,0 +1,487 @@
+#ifndef _ARENADICTIONARY_HPP_
+#define _ARENADICTIONARY_HPP_
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <cstdint>
+#include "Dictionary.hpp"
+
+#define ARENA_CHUNK_SIZE (1 << 20)
+#define EMPTY_INDEX 0
+
+/**
+ * A dictionary that keeps the bytes of its keys and values in an arena: a
+ * list of large chunks that are filled one after the other, and never
+ * reallocated. The key and the value of an item are stored next to each
+ * other, and the item itself only holds where they are, so an item costs
+ * no allocation of its own. A record that is larger than a chunk gets a
+ * chunk of its own size.
+ * The items are kept densely in a vector, and found through an
+ * open-addressed index with linear probing, which holds their positions in
+ * the vector. Erasing an item moves the last item into its place, and
+ * shifts the index back, so there are no tombstones.
+ * The bytes of erased items and of replaced values are not reused until
+ * compact() copies the live records into new chunks.
+ * The string views that are returned stay valid until their item is erased
+ * or assigned, or until compact() or clear() is called.
+ */
+class ArenaDictionary
+{
+ public:
+
+  /**
+   * An empty constructor of ArenaDictionary.
+   */
+  ArenaDictionary ()
+  {
+    index_.assign (DEFAULT_CAPACITY, EMPTY_INDEX);
+  }
+
+  /**
+   * This method returns the size of the dictionary.
+   * @return size of the dictionary.
+   */
+  int size () const
+  {
+    return (int) items_.size ();
+  }
+
+  /**
+   * This method check if the dictionary is empty.
+   * @return true if the dictionary is empty, false otherwise.
+   */
+  bool empty () const
+  {
+    return items_.empty ();
+  }
+
+  /**
+   * This method returns the number of slots of the index.
+   * @return capacity of the dictionary.
+   */
+  int capacity () const
+  {
+    return (int) index_.size ();
+  }
+
+  /**
+   * This method returns the number of bytes of the chunks of the arena.
+   * @return the size of the arena.
+   */
+  size_t arena_bytes () const
+  {
+    size_t bytes = 0;
+    for (const auto &chunk: chunks_)
+    {
+      bytes += chunk.size;
+    }
+    return bytes;
+  }
+
+  /**
+   * This method returns the number of bytes of the arena that belong to
+   * erased items and replaced values, which compact() reclaims.
+   * @return the number of dead bytes.
+   */
+  size_t dead_bytes () const
+  {
+    return dead_bytes_;
+  }
+
+  /**
+   * This method insert a key-value pair into the dictionary.
+   * @param key
+   * @param value
+   * @return true if the key-value pair is inserted, false if the key is
+   * already in the dictionary.
+   */
+  bool insert (std::string_view key, std::string_view value)
+  {
+    size_t key_hash = std::hash<std::string_view>{} (key);
+    if (find_slot (key, key_hash) != nullptr)
+    {
+      return false;
+    }
+    add (key, value, key_hash);
+    return true;
+  }
+
+  /**
+   * This method sets the value of a key: the value of an existing key is
+   * replaced, and a missing key is inserted. A value that is not longer
+   * than the one it replaces is written over it.
+   * @param key
+   * @param value
+   * @return true if the key-value pair is inserted, false if the value of an
+   * existing key was replaced.
+   */
+  bool insert_or_assign (std::string_view key, std::string_view value)
+  {
+    size_t key_hash = std::hash<std::string_view>{} (key);
+    uint32_t *slot = find_slot (key, key_hash);
+    if (slot == nullptr)
+    {
+      add (key, value, key_hash);
+      return true;
+    }
+    Item &item = items_[*slot - 1];
+    if (value.size () <= item.value_length)
+    {
+      char *bytes = chunks_[item.chunk].data.get () + item.offset;
+      // The value may be a view of the bytes it replaces.
+      std::memmove (bytes + item.key_length, value.data (), value.size ());
+      dead_bytes_ += item.value_length - value.size ();
+      item.value_length = (uint32_t) value.size ();
+      return false;
+    }
+    dead_bytes_ += item.key_length + item.value_length;
+    Item moved = store (key, value, key_hash);
+    items_[*slot - 1] = moved;
+    return false;
+  }
+
+  /**
+   * This method check if a key is in the dictionary.
+   * @param key
+   * @return true if the key is in the dictionary, false otherwise.
+   */
+  bool contains_key (std::string_view key) const
+  {
+    return find_slot (key, std::hash<std::string_view>{} (key)) != nullptr;
+  }
+
+  /**
+   * This method looks for a key.
+   * @param key
+   * @param value set to the value of the key, if the key is found.
+   * @return true if the key is in the dictionary, false otherwise.
+   */
+  bool find (std::string_view key, std::string_view &value) const
+  {
+    const uint32_t *slot = find_slot (key, std::hash<std::string_view>{} (
+        key));
+    if (slot == nullptr)
+    {
+      return false;
+    }
+    value = value_of (items_[*slot - 1]);
+    return true;
+  }
+
+  /**
+   * This method returns the value of a key.
+   * @param key
+   * @return if the key is in the dictionary, return the value of the key,
+   * otherwise, throw an exception.
+   */
+  std::string_view at (std::string_view key) const
+  {
+    std::string_view value;
+    if (!find (key, value))
+    {
+      throw std::out_of_range (MESSAGE_KEY_NOT_FOUND);
+    }
+    return value;
+  }
+
+  /**
+   * This method get a key and if the key is in the dictionary,
+   * it erase the value associated with the key.
+   * If the key is not in the dictionary, it throws an exception.
+   * @param key The key.
+   * @return True if the erase was successful, otherwise it throws an
+   * exception.
+   */
+  bool erase (std::string_view key)
+  {
+    size_t key_hash = std::hash<std::string_view>{} (key);
+    uint32_t *slot = find_slot (key, key_hash);
+    if (slot == nullptr)
+    {
+      throw InvalidKey (MESSAGE_KEY_NOT_FOUND);
+    }
+    uint32_t position = *slot - 1;
+    dead_bytes_ += items_[position].key_length
+                   + items_[position].value_length;
+    remove_slot (slot);
+    uint32_t last = (uint32_t) items_.size () - 1;
+    if (position != last)
+    {
+      // The last item takes the place of the erased one.
+      *slot_of (last) = position + 1;
+      items_[position] = items_[last];
+    }
+    items_.pop_back ();
+    return true;
+  }
+
+  /**
+   * This method get two iterators and it updates the dictionary with the
+   * items that are in this range: the value of an existing key is replaced,
+   * and a missing key is added.
+   * @tparam ForwardIterator The type of the iterators.
+   * @param first The first iterator.
+   * @param last The last iterator.
+   */
+  template<class ForwardIterator>
+  void update (ForwardIterator first, ForwardIterator last)
+  {
+    for (; first != last; ++first)
+    {
+      insert_or_assign (first->first, first->second);
+    }
+  }
+
+  /**
+   * This method calls a function with every key and value.
+   * @tparam Function a callable that takes (std::string_view key,
+   * std::string_view value).
+   * @param function the function.
+   */
+  template<class Function>
+  void for_each (Function function) const
+  {
+    for (const auto &item: items_)
+    {
+      function (key_of (item), value_of (item));
+    }
+  }
+
+  /**
+   * This method copies the records of the live items into new chunks, one
+   * after the other, and frees the old chunks, so that the bytes of erased
+   * items and replaced values are reclaimed.
+   */
+  void compact ()
+  {
+    std::vector<Chunk> old_chunks;
+    old_chunks.swap (chunks_);
+    for (auto &item: items_)
+    {
+      const char *bytes = old_chunks[item.chunk].data.get () + item.offset;
+      Item moved = store (std::string_view (bytes, item.key_length),
+                          std::string_view (bytes + item.key_length,
+                                            item.value_length), item.hash);
+      item = moved;
+    }
+    dead_bytes_ = 0;
+  }
+
+  /**
+   * This method removes all the items from the dictionary, and frees the
+   * arena.
+   */
+  void clear ()
+  {
+    items_.clear ();
+    chunks_.clear ();
+    index_.assign (DEFAULT_CAPACITY, EMPTY_INDEX);
+    dead_bytes_ = 0;
+  }
+
+ private:
+
+  /**
+   * An item: where its record is in the arena, and the hash of its key.
+   */
+  struct Item
+  {
+    size_t hash;
+    uint32_t chunk;
+    uint32_t offset;
+    uint32_t key_length;
+    uint32_t value_length;
+  };
+
+  /**
+   * A chunk of the arena.
+   */
+  struct Chunk
+  {
+    std::unique_ptr<char[]> data;
+    size_t size;
+    size_t used;
+  };
+
+  std::vector<Item> items_;
+  // Positions of the items in items_, plus 1. EMPTY_INDEX marks a free
+  // slot.
+  std::vector<uint32_t> index_;
+  std::vector<Chunk> chunks_;
+  size_t dead_bytes_ = 0;
+
+  /**
+   * @param item an item.
+   * @return the key of the item.
+   */
+  std::string_view key_of (const Item &item) const
+  {
+    return std::string_view (chunks_[item.chunk].data.get () + item.offset,
+                             item.key_length);
+  }
+
+  /**
+   * @param item an item.
+   * @return the value of the item.
+   */
+  std::string_view value_of (const Item &item) const
+  {
+    return std::string_view (chunks_[item.chunk].data.get () + item.offset
+                             + item.key_length, item.value_length);
+  }
+
+  /**
+   * This function copies a key and a value to the end of the arena. A new
+   * chunk is started if they do not fit in the last one.
+   * @param key the key.
+   * @param value the value.
+   * @param key_hash the hash of the key.
+   * @return an item that points at the copy.
+   */
+  Item store (std::string_view key, std::string_view value, size_t key_hash)
+  {
+    size_t length = key.size () + value.size ();
+    if (chunks_.empty ()
+        || chunks_.back ().size - chunks_.back ().used < length)
+    {
+      size_t size = std::max ((size_t) ARENA_CHUNK_SIZE, length);
+      chunks_.push_back (Chunk {std::unique_ptr<char[]> (new char[size]),
+                                size, 0});
+    }
+    Chunk &chunk = chunks_.back ();
+    char *bytes = chunk.data.get () + chunk.used;
+    std::memcpy (bytes, key.data (), key.size ());
+    std::memcpy (bytes + key.size (), value.data (), value.size ());
+    Item item {key_hash, (uint32_t) (chunks_.size () - 1),
+               (uint32_t) chunk.used, (uint32_t) key.size (),
+               (uint32_t) value.size ()};
+    chunk.used += length;
+    return item;
+  }
+
+  /**
+   * This function adds an item whose key is not in the dictionary, and
+   * grows the index first if the item would pass the max load factor.
+   * @param key the key.
+   * @param value the value.
+   * @param key_hash the hash of the key.
+   */
+  void add (std::string_view key, std::string_view value, size_t key_hash)
+  {
+    if ((double) (items_.size () + 1) / index_.size () > MAX_LOAD_FACTOR)
+    {
+      grow ();
+    }
+    items_.push_back (store (key, value, key_hash));
+    size_t mask = index_.size () - 1;
+    size_t slot = key_hash & mask;
+    while (index_[slot] != EMPTY_INDEX)
+    {
+      slot = (slot + 1) & mask;
+    }
+    index_[slot] = (uint32_t) items_.size ();
+  }
+
+  /**
+   * This function doubles the index, and puts every item in it again by its
+   * cached hash.
+   */
+  void grow ()
+  {
+    index_.assign (index_.size () * RESIZE_FACTOR, EMPTY_INDEX);
+    size_t mask = index_.size () - 1;
+    for (size_t position = 0; position < items_.size (); position++)
+    {
+      size_t slot = items_[position].hash & mask;
+      while (index_[slot] != EMPTY_INDEX)
+      {
+        slot = (slot + 1) & mask;
+      }
+      index_[slot] = (uint32_t) position + 1;
+    }
+  }
+
+  /**
+   * This function looks for the slot of a key.
+   * @param key the key.
+   * @param key_hash the hash of the key.
+   * @return pointer to the slot of the key, or nullptr.
+   */
+  const uint32_t *find_slot (std::string_view key, size_t key_hash) const
+  {
+    size_t mask = index_.size () - 1;
+    for (size_t slot = key_hash & mask;; slot = (slot + 1) & mask)
+    {
+      uint32_t position = index_[slot];
+      if (position == EMPTY_INDEX)
+      {
+        return nullptr;
+      }
+      const Item &item = items_[position - 1];
+      if (item.hash == key_hash && key_of (item) == key)
+      {
+        return &index_[slot];
+      }
+    }
+  }
+
+  /**
+   * This function looks for the slot of a key.
+   * @param key the key.
+   * @param key_hash the hash of the key.
+   * @return pointer to the slot of the key, or nullptr.
+   */
+  uint32_t *find_slot (std::string_view key, size_t key_hash)
+  {
+    return const_cast<uint32_t *> (
+        static_cast<const ArenaDictionary *> (this)->find_slot (key,
+                                                                key_hash));
+  }
+
+  /**
+   * This function finds the slot that points at an item.
+   * @param position the position of the item in items_.
+   * @return pointer to the slot.
+   */
+  uint32_t *slot_of (uint32_t position)
+  {
+    size_t mask = index_.size () - 1;
+    size_t slot = items_[position].hash & mask;
+    while (index_[slot] != position + 1)
+    {
+      slot = (slot + 1) & mask;
+    }
+    return &index_[slot];
+  }
+
+  /**
+   * This function empties a slot, and shifts back the following slots of
+   * the probe run that may now be found earlier.
+   * @param slot the slot.
+   */
+  void remove_slot (uint32_t *slot)
+  {
+    size_t mask = index_.size () - 1;
+    size_t hole = slot - index_.data ();
+    for (size_t next = (hole + 1) & mask; index_[next] != EMPTY_INDEX;
+         next = (next + 1) & mask)
+    {
+      size_t home = items_[index_[next] - 1].hash & mask;
+      // The item at next may move to the hole if its home slot is not in
+      // the cyclic range (hole, next].
+      if (((next - home) & mask) >= ((next - hole) & mask))
+      {
+        index_[hole] = index_[next];
+        hole = next;
+      }
+    }
+    index_[hole] = EMPTY_INDEX;
+  }
+};
+
+#endif //_ARENADICTIONARY_HPP_
@@ -0,0 +1,9 @@
+#ifndef _CACHELINE_HPP_
+#define _CACHELINE_HPP_
+
+// The size of a cache line, which data that different threads write must not
+// share. std::hardware_destructive_interference_size is not used, since its
+// value may differ between the compilers that build the headers.
+#define CACHE_LINE_SIZE 64
+
+#endif //_CACHELINE_HPP_
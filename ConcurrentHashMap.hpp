@@ -0,0 +1,353 @@
+#ifndef _CONCURRENTHASHMAP_HPP_
+#define _CONCURRENTHASHMAP_HPP_
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <functional>
+#include <utility>
+#include "HashMap.hpp"
+#include "CacheLine.hpp"
+
+#define LOCK_STRIPES 64
+
+/**
+ * A hash map that can be shared by many threads. It has the bucket layout
+ * of HashMap: a table of buckets, each a vector of entries that cache the
+ * hash of their key. The buckets are guarded by LOCK_STRIPES reader/writer
+ * locks: bucket i is guarded by stripe i % LOCK_STRIPES. Since the capacity
+ * is a power of two that is at least LOCK_STRIPES, the stripe of a key only
+ * depends on its hash, and does not change when the table is resized.
+ * Lookups take a shared lock of one stripe, updates an exclusive lock of one
+ * stripe, and a resize takes all the stripes.
+ * Values are copied out of the map, since a reference into a bucket would
+ * not be safe once the lock is released. The map grows, but never shrinks.
+ */
+template<typename KeyT, typename ValueT>
+class ConcurrentHashMap
+{
+ public:
+
+  /**
+   * Default constructor
+   */
+  ConcurrentHashMap ()
+  {
+    size_ = INITIAL_INT;
+    capacity_ = LOCK_STRIPES;
+    hash_table_ = new bucket[capacity_];
+  }
+
+  ConcurrentHashMap (const ConcurrentHashMap &other) = delete;
+
+  ConcurrentHashMap &operator= (const ConcurrentHashMap &other) = delete;
+
+  /**
+   * Destructor
+   */
+  ~ConcurrentHashMap ()
+  {
+    delete[] hash_table_;
+  }
+
+  /**
+   * This method returns the size of the hash map. Other threads may change
+   * it right after it is read.
+   * @return size of the hash map.
+   */
+  int size () const
+  {
+    return size_.load ();
+  }
+
+  /**
+   * This method check if the hash map is empty.
+   * @return true if the hash map is empty, false otherwise.
+   */
+  bool empty () const
+  {
+    return size () == INITIAL_INT;
+  }
+
+  /**
+   * This method returns the capacity of the hash map.
+   * @return capacity of the hash map.
+   */
+  int capacity () const
+  {
+    std::shared_lock<std::shared_mutex> lock (stripes_[0].mutex);
+    return capacity_;
+  }
+
+  /**
+   * This method insert a key-value pair into the hash map.
+   * @param key
+   * @param value
+   * @return true if the key-value pair is inserted, false if the key is
+   * already in the hash map.
+   */
+  bool insert (const KeyT &key, const ValueT &value)
+  {
+    size_t key_hash = std::hash<KeyT>{} (key);
+    int capacity;
+    {
+      std::unique_lock<std::shared_mutex> lock (stripe_of (key_hash).mutex);
+      if (find_entry (key, key_hash) != nullptr)
+      {
+        return false;
+      }
+      hash_table_[key_hash & (capacity_ - 1)].push_back (
+          Entry {std::make_pair (key, value), key_hash});
+      capacity = capacity_;
+    }
+    grow_if_needed (size_.fetch_add (1) + 1, capacity);
+    return true;
+  }
+
+  /**
+   * This method sets the value of a key: the value of an existing key is
+   * replaced, and a missing key is inserted.
+   * @param key
+   * @param value
+   * @return true if the key-value pair is inserted, false if the value of an
+   * existing key was replaced.
+   */
+  bool insert_or_assign (const KeyT &key, const ValueT &value)
+  {
+    size_t key_hash = std::hash<KeyT>{} (key);
+    int capacity;
+    {
+      std::unique_lock<std::shared_mutex> lock (stripe_of (key_hash).mutex);
+      Entry *entry = find_entry (key, key_hash);
+      if (entry != nullptr)
+      {
+        entry->item.second = value;
+        return false;
+      }
+      hash_table_[key_hash & (capacity_ - 1)].push_back (
+          Entry {std::make_pair (key, value), key_hash});
+      capacity = capacity_;
+    }
+    grow_if_needed (size_.fetch_add (1) + 1, capacity);
+    return true;
+  }
+
+  /**
+   * This method looks for a key and copies its value out.
+   * @param key
+   * @param value set to the value of the key, if the key is found.
+   * @return true if the key is in the hash map, false otherwise.
+   */
+  bool find (const KeyT &key, ValueT &value) const
+  {
+    size_t key_hash = std::hash<KeyT>{} (key);
+    std::shared_lock<std::shared_mutex> lock (stripe_of (key_hash).mutex);
+    const Entry *entry = find_entry (key, key_hash);
+    if (entry == nullptr)
+    {
+      return false;
+    }
+    value = entry->item.second;
+    return true;
+  }
+
+  /**
+   * This method check if a key is in the hash map.
+   * @param key
+   * @return true if the key is in the hash map, false otherwise.
+   */
+  bool contains_key (const KeyT &key) const
+  {
+    size_t key_hash = std::hash<KeyT>{} (key);
+    std::shared_lock<std::shared_mutex> lock (stripe_of (key_hash).mutex);
+    return find_entry (key, key_hash) != nullptr;
+  }
+
+  /**
+   * This method applies a function to the value of a key, while holding the
+   * lock of its stripe, so that reading and changing the value is atomic.
+   * The function must not call back into the hash map.
+   * @tparam Function a callable that takes a ValueT &.
+   * @param key
+   * @param function the function to apply.
+   * @return true if the key is in the hash map, false otherwise.
+   */
+  template<class Function>
+  bool update (const KeyT &key, Function function)
+  {
+    size_t key_hash = std::hash<KeyT>{} (key);
+    std::unique_lock<std::shared_mutex> lock (stripe_of (key_hash).mutex);
+    Entry *entry = find_entry (key, key_hash);
+    if (entry == nullptr)
+    {
+      return false;
+    }
+    function (entry->item.second);
+    return true;
+  }
+
+  /**
+   * This method erase a key-value pair from the hash map.
+   * @param key
+   * @return if the key is in the hash map, erase the key-value pair and
+   * return true, otherwise, return false.
+   */
+  bool erase (const KeyT &key)
+  {
+    size_t key_hash = std::hash<KeyT>{} (key);
+    std::unique_lock<std::shared_mutex> lock (stripe_of (key_hash).mutex);
+    bucket &items = hash_table_[key_hash & (capacity_ - 1)];
+    for (size_t i = 0; i < items.size (); i++)
+    {
+      if (items[i].hash == key_hash && items[i].item.first == key)
+      {
+        if (i + 1 != items.size ())
+        {
+          items[i] = std::move (items.back ());
+        }
+        items.pop_back ();
+        size_.fetch_sub (1);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * This method removes all the items from the hash map. The capacity is
+   * not changed.
+   */
+  void clear ()
+  {
+    AllStripesLock lock (*this);
+    for (int i = 0; i < capacity_; i++)
+    {
+      hash_table_[i].clear ();
+    }
+    size_.store (INITIAL_INT);
+  }
+
+ private:
+  typedef std::pair<KeyT, ValueT> Pair;
+
+  /**
+   * An item of the hash map together with the full hash of its key.
+   */
+  struct Entry
+  {
+    Pair item;
+    size_t hash;
+  };
+
+  typedef std::vector<Entry> bucket;
+
+  /**
+   * A lock on its own cache line, so that threads that take different
+   * stripes do not slow each other down.
+   */
+  struct alignas(CACHE_LINE_SIZE) Stripe
+  {
+    mutable std::shared_mutex mutex;
+  };
+
+  Stripe stripes_[LOCK_STRIPES];
+  std::atomic<int> size_;
+  int capacity_;
+  bucket *hash_table_;
+
+  /**
+   * @param key_hash the full hash of a key.
+   * @return the stripe that guards the bucket of the key.
+   */
+  const Stripe &stripe_of (size_t key_hash) const
+  {
+    return stripes_[key_hash & (LOCK_STRIPES - 1)];
+  }
+
+  /**
+   * This function looks for the entry of a key. The stripe of the key must
+   * be locked.
+   * @param key the key.
+   * @param key_hash the full hash of the key.
+   * @return pointer to the entry of the key, or nullptr.
+   */
+  Entry *find_entry (const KeyT &key, size_t key_hash) const
+  {
+    bucket &items = hash_table_[key_hash & (capacity_ - 1)];
+    for (size_t i = 0; i < items.size (); i++)
+    {
+      if (items[i].hash == key_hash && items[i].item.first == key)
+      {
+        return &items[i];
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+   * This function doubles the capacity if the given size passes the max
+   * load factor. If another thread resized the table in the meantime,
+   * nothing is done.
+   * @param size the size after an insert.
+   * @param capacity the capacity the insert saw.
+   */
+  void grow_if_needed (int size, int capacity)
+  {
+    if ((double) size / capacity <= MAX_LOAD_FACTOR)
+    {
+      return;
+    }
+    AllStripesLock lock (*this);
+    if (capacity_ == capacity)
+    {
+      int new_capacity = capacity_ * RESIZE_FACTOR;
+      auto *new_hash_table = new bucket[new_capacity];
+      for (int i = 0; i < capacity_; ++i)
+      {
+        for (auto &entry: hash_table_[i])
+        {
+          new_hash_table[entry.hash & (new_capacity - 1)].push_back (
+              std::move (entry));
+        }
+      }
+      delete[] hash_table_;
+      hash_table_ = new_hash_table;
+      capacity_ = new_capacity;
+    }
+  }
+
+  /**
+   * A lock on all the stripes, that are taken always in the same order, so
+   * that two threads that lock them all cannot deadlock. The stripes are
+   * unlocked when the lock is destroyed, also if an exception is thrown
+   * while they are held.
+   */
+  class AllStripesLock
+  {
+   public:
+    explicit AllStripesLock (const ConcurrentHashMap &map) : map_ (map)
+    {
+      for (auto &stripe: map_.stripes_)
+      {
+        stripe.mutex.lock ();
+      }
+    }
+
+    ~AllStripesLock ()
+    {
+      for (auto &stripe: map_.stripes_)
+      {
+        stripe.mutex.unlock ();
+      }
+    }
+
+    AllStripesLock (const AllStripesLock &) = delete;
+    AllStripesLock &operator= (const AllStripesLock &) = delete;
+
+   private:
+    const ConcurrentHashMap &map_;
+  };
+};
+
+#endif //_CONCURRENTHASHMAP_HPP_
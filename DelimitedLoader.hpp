@@ -0,0 +1,158 @@
+#ifndef _DELIMITEDLOADER_HPP_
+#define _DELIMITEDLOADER_HPP_
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include "HashMap.hpp"
+
+#define LOADER_BLOCK_SIZE (1 << 20)
+#define BYTES_PER_MEGABYTE (1024.0 * 1024.0)
+#define MESSAGE_LOADER_OPEN "Cannot open delimited file"
+#define MESSAGE_LOADER_READ "Cannot read delimited file"
+
+/**
+ * What load_delimited read, and how fast.
+ */
+struct LoadStats
+{
+  // The number of bytes of the file.
+  size_t bytes = 0;
+  // The number of lines that were loaded.
+  size_t lines = 0;
+  // The number of lines without a delimiter, which were skipped.
+  size_t malformed = 0;
+  // The time the load took.
+  double seconds = 0;
+
+  /**
+   * @return the throughput of the load.
+   */
+  double megabytes_per_second () const
+  {
+    return seconds > 0 ? (double) bytes / BYTES_PER_MEGABYTE / seconds : 0;
+  }
+};
+
+/**
+ * This function loads a file of "key<delimiter>value" lines, such as a TSV
+ * file or a CSV file without quoting, straight into a hash map, without
+ * collecting the keys and values first. The file is read in blocks into one
+ * bounded buffer, and the line ends and delimiters are found with memchr.
+ * A line that does not fit in the rest of the buffer is carried over to the
+ * start of the buffer before the next block is read; the buffer only grows
+ * for a line longer than itself. Before the first insert, the hash map is
+ * reserved for the number of lines that the file size and the lines of the
+ * first block suggest. The value is everything after the first delimiter;
+ * a "\r" before the line end is dropped, and empty lines are skipped. For a
+ * key that appears more than once, the last value is kept.
+ * @param map the hash map, such as a Dictionary.
+ * @param path the path of the file.
+ * @param delimiter the delimiter between the key and the value.
+ * @param block_size the size of the blocks that are read.
+ * @return what was read, and how fast.
+ */
+inline LoadStats load_delimited (HashMap<std::string, std::string> &map,
+                                 const std::string &path,
+                                 char delimiter = '\t',
+                                 size_t block_size = LOADER_BLOCK_SIZE)
+{
+  auto start = std::chrono::steady_clock::now ();
+  std::unique_ptr<FILE, int (*) (FILE *)> owner (
+      std::fopen (path.c_str (), "rb"), std::fclose);
+  FILE *file = owner.get ();
+  if (file == nullptr)
+  {
+    throw std::runtime_error (MESSAGE_LOADER_OPEN);
+  }
+  LoadStats stats;
+  struct stat status {};
+  size_t file_size = ::fstat (fileno (file), &status) == 0
+                     ? (size_t) status.st_size : 0;
+  std::vector<char> buffer (std::max (block_size, (size_t) 1));
+  size_t carried = 0;
+  bool reserved = false;
+  bool end_of_file = false;
+  while (!end_of_file)
+  {
+    if (carried == buffer.size ())
+    {
+      buffer.resize (buffer.size () * 2);
+    }
+    size_t read = std::fread (buffer.data () + carried, 1,
+                              buffer.size () - carried, file);
+    if (read < buffer.size () - carried)
+    {
+      if (std::ferror (file))
+      {
+        throw std::runtime_error (MESSAGE_LOADER_READ);
+      }
+      end_of_file = true;
+    }
+    stats.bytes += read;
+    const char *data = buffer.data ();
+    const char *end = data + carried + read;
+    if (!reserved)
+    {
+      // Estimate the number of lines from the average line of this block.
+      size_t lines = 0;
+      for (const char *p = data; (p = (const char *) std::memchr (
+          p, '\n', end - p)) != nullptr; p++)
+      {
+        lines++;
+      }
+      if (lines > 0 && end > data)
+      {
+        // Several GB of short lines may pass what an int holds.
+        double estimate = file_size / ((end - data) / (double) lines);
+        map.reserve ((int) std::min<double> (estimate, MAX_CAPACITY));
+      }
+      reserved = true;
+    }
+    const char *line = data;
+    while (line < end)
+    {
+      auto *newline = (const char *) std::memchr (line, '\n', end - line);
+      if (newline == nullptr && !end_of_file)
+      {
+        break;
+      }
+      const char *line_end = newline != nullptr ? newline : end;
+      const char *next = newline != nullptr ? newline + 1 : end;
+      if (line_end > line && line_end[-1] == '\r')
+      {
+        line_end--;
+      }
+      if (line_end > line)
+      {
+        auto *separator = (const char *) std::memchr (line, delimiter,
+                                                      line_end - line);
+        if (separator == nullptr)
+        {
+          stats.malformed++;
+        }
+        else
+        {
+          map.insert_or_assign (std::string (line, separator),
+                                std::string (separator + 1, line_end));
+          stats.lines++;
+        }
+      }
+      line = next;
+    }
+    carried = end - line;
+    std::memmove (buffer.data (), line, carried);
+  }
+  stats.seconds = std::chrono::duration<double> (
+      std::chrono::steady_clock::now () - start).count ();
+  return stats;
+}
+
+#endif //_DELIMITEDLOADER_HPP_
@@ -5,6 +5,7 @@
 #include <stdexcept>
 #include <string>
 #include "HashMap.hpp"
+#include "PerfectHashMap.hpp"
 
 #define INVALID_KEY_MSG "Invalid key"
 
@@ -57,10 +58,11 @@ class Dictionary : public HashMap<std::string, std::string>
    * of HashMap.
    * @param Key_Vector this is a vector of keys.
    * @param Value_Vector this is a vector of values.
+   * @param threads the number of threads to load with, see HashMap.
    */
   Dictionary (std::vector<std::string> Key_Vector,
-              std::vector<std::string> Value_Vector)
-      : HashMap (std::move (Key_Vector), std::move (Value_Vector))
+              std::vector<std::string> Value_Vector, int threads = 0)
+      : HashMap (std::move (Key_Vector), std::move (Value_Vector), threads)
   {
   }
 
@@ -73,18 +75,38 @@ class Dictionary : public HashMap<std::string, std::string>
    * @return True if the erase was successful, otherwise it throws an
    * exception.
    */
-  bool erase (std::string Key) override
+  bool erase (const std::string &Key) override
   {
-    if (!HashMap<std::string, std::string>::contains_key (Key))
+    if (!HashMap<std::string, std::string>::erase (Key))
     {
       throw InvalidKey (MESSAGE_KEY_NOT_FOUND);
     }
-    return HashMap<std::string, std::string>::erase (Key);
+    return true;
+  }
+
+  /**
+   * This method is erase for a key that is looked up without building a
+   * std::string from it, such as a std::string_view or a const char*.
+   * @param Key The key.
+   * @return True if the erase was successful, otherwise it throws an
+   * exception.
+   */
+  template<class K, class View = typename transparent_key<std::string,
+                                                          K>::type>
+  bool erase (const K &Key)
+  {
+    if (!HashMap<std::string, std::string>::erase (View (Key)))
+    {
+      throw InvalidKey (MESSAGE_KEY_NOT_FOUND);
+    }
+    return true;
   }
 
   /**
    * This method get two iterators and it updates the dictionary with the
-   * items that are in this range.
+   * items that are in this range. Every item costs a single lookup: the
+   * value of an existing key is replaced, and a missing key is added. See
+   * HashMap::update for how forward ranges are presized and prefetched.
    * @tparam ForwardIterator The type of the iterators.
    * @param first The first iterator.
    * @param last The last iterator.
@@ -92,22 +114,20 @@ class Dictionary : public HashMap<std::string, std::string>
   template<class ForwardIterator>
   void update (ForwardIterator first, ForwardIterator last)
   {
-    if (first == last)
-    {
-      return;
-    }
-    while (first != last)
-    {
-      if (contains_key (first->first))
-      {
-        this->operator[] (first->first) = first->second;
-      }
-      else
-      {
-        insert (first->first, first->second);
-      }
-      ++first;
-    }
+    HashMap<std::string, std::string>::update (first, last);
+  }
+
+  /**
+   * This method builds an immutable copy of the dictionary, on a minimal
+   * perfect hash function, for a dictionary that does not change anymore.
+   * See PerfectHashMap.
+   * @param threads the number of threads that build it, 0 for all the
+   * hardware threads.
+   * @return the perfect hash map of the items of the dictionary.
+   */
+  PerfectHashMap<std::string, std::string> freeze (int threads = 0) const
+  {
+    return PerfectHashMap<std::string, std::string> (*this, threads);
   }
 
 };
@@ -0,0 +1,389 @@
+#ifndef _FROZENDICTIONARY_HPP_
+#define _FROZENDICTIONARY_HPP_
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "HashMap.hpp"
+#include "Hashers.hpp"
+
+#define FROZEN_MAGIC "FRZDICT"
+#define FROZEN_VERSION 1
+#define FROZEN_MAX_LOAD_FACTOR 0.5
+#define FROZEN_EMPTY_SLOT UINT64_MAX
+#define FROZEN_TEMPORARY_SUFFIX ".tmp"
+#define MESSAGE_FROZEN_OPEN "Cannot open frozen dictionary file"
+#define MESSAGE_FROZEN_WRITE "Cannot write frozen dictionary file"
+#define MESSAGE_FROZEN_INVALID "Invalid frozen dictionary file"
+
+/**
+ * A read-only dictionary that lives in a file, and is used straight from a
+ * memory mapping of it. Opening it maps the file and checks its header and
+ * its table of slots, but never reads or copies the keys and values, and
+ * processes that open the same file share its pages in the page cache.
+ * The file has three parts, in this order:
+ * - a Header,
+ * - an open-addressed table of slot_count Slots (a power of two, at most
+ *   half full, probed linearly), each holding the hash of a key and the
+ *   offsets and lengths of the key and the value in the blob,
+ * - the blob: all the keys and values, one after the other.
+ * Offsets are relative to the start of the blob. The hash is FNV-1a, which
+ * does not depend on the standard library. Numbers are written in the byte
+ * order of the host, so a file is only read on hosts of the same order.
+ */
+class FrozenDictionary
+{
+ public:
+
+  /**
+   * This function writes the items of a hash map to a frozen dictionary
+   * file. The file is written next to its path, synced, and then renamed
+   * over it, so processes that map the old file keep reading it unchanged,
+   * and a crash never leaves a torn file at the path.
+   * @param map the hash map.
+   * @param path the path of the file. An existing file is replaced.
+   */
+  static void write (const HashMap<std::string, std::string> &map,
+                     const std::string &path)
+  {
+    uint64_t slot_count = 1;
+    while ((double) map.size () / slot_count > FROZEN_MAX_LOAD_FACTOR)
+    {
+      slot_count *= 2;
+    }
+    std::vector<Slot> slots (slot_count,
+                             Slot {0, FROZEN_EMPTY_SLOT, 0, 0, 0});
+    std::string blob;
+    for (const auto &item: map)
+    {
+      uint64_t key_hash = hash (item.first);
+      uint64_t index = key_hash & (slot_count - 1);
+      while (slots[index].key_offset != FROZEN_EMPTY_SLOT)
+      {
+        index = (index + 1) & (slot_count - 1);
+      }
+      Slot &slot = slots[index];
+      slot.hash = key_hash;
+      slot.key_offset = blob.size ();
+      slot.key_length = (uint32_t) item.first.size ();
+      blob += item.first;
+      slot.value_offset = blob.size ();
+      slot.value_length = (uint32_t) item.second.size ();
+      blob += item.second;
+    }
+
+    Header header {};
+    std::memcpy (header.magic, FROZEN_MAGIC, sizeof (FROZEN_MAGIC));
+    header.version = FROZEN_VERSION;
+    header.slot_size = sizeof (Slot);
+    header.size = (uint64_t) map.size ();
+    header.slot_count = slot_count;
+    header.slots_offset = sizeof (Header);
+    header.blob_offset = sizeof (Header) + slot_count * sizeof (Slot);
+    header.blob_size = blob.size ();
+
+    std::string temporary = path + FROZEN_TEMPORARY_SUFFIX;
+    FILE *file = std::fopen (temporary.c_str (), "wb");
+    if (file == nullptr)
+    {
+      throw std::runtime_error (MESSAGE_FROZEN_WRITE);
+    }
+    bool written = std::fwrite (&header, sizeof (Header), 1, file) == 1
+                   && std::fwrite (slots.data (), sizeof (Slot), slot_count,
+                                   file) == slot_count
+                   && std::fwrite (blob.data (), 1, blob.size (), file)
+                      == blob.size ()
+                   && std::fflush (file) == 0 && ::fsync (::fileno (file)) == 0;
+    if (std::fclose (file) != 0 || !written
+        || std::rename (temporary.c_str (), path.c_str ()) != 0)
+    {
+      std::remove (temporary.c_str ());
+      throw std::runtime_error (MESSAGE_FROZEN_WRITE);
+    }
+  }
+
+  /**
+   * A constructor that maps a frozen dictionary file.
+   * @param path the path of the file.
+   */
+  explicit FrozenDictionary (const std::string &path)
+  {
+    int fd = ::open (path.c_str (), O_RDONLY);
+    if (fd < 0)
+    {
+      throw std::runtime_error (MESSAGE_FROZEN_OPEN);
+    }
+    struct stat status {};
+    if (::fstat (fd, &status) != 0 || status.st_size < (off_t) sizeof (Header))
+    {
+      ::close (fd);
+      throw std::runtime_error (MESSAGE_FROZEN_INVALID);
+    }
+    length_ = (size_t) status.st_size;
+    void *mapping = ::mmap (nullptr, length_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close (fd);
+    if (mapping == MAP_FAILED)
+    {
+      throw std::runtime_error (MESSAGE_FROZEN_OPEN);
+    }
+    mapping_ = (const char *) mapping;
+    header_ = (const Header *) mapping_;
+    if (!valid ())
+    {
+      ::munmap (mapping, length_);
+      throw std::runtime_error (MESSAGE_FROZEN_INVALID);
+    }
+    slots_ = (const Slot *) (mapping_ + header_->slots_offset);
+    blob_ = mapping_ + header_->blob_offset;
+  }
+
+  /**
+   * Move constructor
+   * @param other the dictionary to move from. It is left empty.
+   */
+  FrozenDictionary (FrozenDictionary &&other) noexcept
+      : mapping_ (other.mapping_), length_ (other.length_),
+        header_ (other.header_), slots_ (other.slots_), blob_ (other.blob_)
+  {
+    other.mapping_ = nullptr;
+  }
+
+  FrozenDictionary (const FrozenDictionary &other) = delete;
+
+  FrozenDictionary &operator= (const FrozenDictionary &other) = delete;
+
+  /**
+   * Destructor. The string views it returned are not valid anymore.
+   */
+  ~FrozenDictionary ()
+  {
+    if (mapping_ != nullptr)
+    {
+      ::munmap ((void *) mapping_, length_);
+    }
+  }
+
+  /**
+   * This method returns the number of items.
+   * @return size of the dictionary.
+   */
+  int size () const
+  {
+    return (int) header_->size;
+  }
+
+  /**
+   * This method check if the dictionary is empty.
+   * @return true if the dictionary is empty, false otherwise.
+   */
+  bool empty () const
+  {
+    return size () == INITIAL_INT;
+  }
+
+  /**
+   * This method looks for a key.
+   * @param key
+   * @param value set to the value of the key, if the key is found. It points
+   * into the mapping, and is valid as long as the dictionary is.
+   * @return true if the key is in the dictionary, false otherwise.
+   */
+  bool find (std::string_view key, std::string_view &value) const
+  {
+    const Slot *slot = find_slot (key);
+    if (slot == nullptr)
+    {
+      return false;
+    }
+    value = std::string_view (blob_ + slot->value_offset, slot->value_length);
+    return true;
+  }
+
+  /**
+   * This method check if a key is in the dictionary.
+   * @param key
+   * @return true if the key is in the dictionary, false otherwise.
+   */
+  bool contains_key (std::string_view key) const
+  {
+    return find_slot (key) != nullptr;
+  }
+
+  /**
+   * This method returns the value of a key.
+   * @param key
+   * @return if the key is in the dictionary, return its value, which points
+   * into the mapping, otherwise, throw an exception.
+   */
+  std::string_view at (std::string_view key) const
+  {
+    std::string_view value;
+    if (!find (key, value))
+    {
+      throw std::out_of_range (MESSAGE_KEY_NOT_FOUND);
+    }
+    return value;
+  }
+
+  /**
+   * This method calls a function with every key and value, in slot order.
+   * @tparam Function a callable that takes (std::string_view key,
+   * std::string_view value).
+   * @param function the function.
+   */
+  template<class Function>
+  void for_each (Function function) const
+  {
+    for (uint64_t i = 0; i < header_->slot_count; i++)
+    {
+      const Slot &slot = slots_[i];
+      if (slot.key_offset != FROZEN_EMPTY_SLOT)
+      {
+        function (std::string_view (blob_ + slot.key_offset, slot.key_length),
+                  std::string_view (blob_ + slot.value_offset,
+                                    slot.value_length));
+      }
+    }
+  }
+
+  /**
+   * The hash of the keys of the file format: 64-bit FNV-1a.
+   * @param key
+   * @return the hash of the key.
+   */
+  static uint64_t hash (std::string_view key)
+  {
+    uint64_t result = fnv1a (key);
+    // FNV-1a mixes the last bytes poorly into the low bits, which pick the
+    // slot.
+    return result ^ (result >> 32);
+  }
+
+ private:
+
+  /**
+   * The header at the start of the file.
+   */
+  struct Header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_size;
+    uint64_t size;
+    uint64_t slot_count;
+    uint64_t slots_offset;
+    uint64_t blob_offset;
+    uint64_t blob_size;
+  };
+
+  /**
+   * A slot of the table. Empty slots have a key offset of FROZEN_EMPTY_SLOT.
+   */
+  struct Slot
+  {
+    uint64_t hash;
+    uint64_t key_offset;
+    uint64_t value_offset;
+    uint32_t key_length;
+    uint32_t value_length;
+  };
+
+  const char *mapping_ = nullptr;
+  size_t length_ = 0;
+  const Header *header_ = nullptr;
+  const Slot *slots_ = nullptr;
+  const char *blob_ = nullptr;
+
+  /**
+   * This function checks that the mapped file is a frozen dictionary whose
+   * parts fit in it: the header, and then every slot, whose key and value
+   * must lie in the blob, and whose count must match the header, so the
+   * table has empty slots to end a probe.
+   * @return true if the file is valid, false otherwise.
+   */
+  bool valid () const
+  {
+    const Header &header = *header_;
+    uint64_t slot_count = header.slot_count;
+    if (std::memcmp (header.magic, FROZEN_MAGIC, sizeof (FROZEN_MAGIC)) != 0
+        || header.version != FROZEN_VERSION
+        || header.slot_size != sizeof (Slot)
+        || slot_count == 0 || (slot_count & (slot_count - 1)) != 0
+        || slot_count > length_ / sizeof (Slot)
+        || header.size * 2 > slot_count
+        || header.slots_offset != sizeof (Header)
+        || header.blob_offset
+           != sizeof (Header) + slot_count * sizeof (Slot)
+        || header.blob_offset > length_
+        || header.blob_size != length_ - header.blob_offset)
+    {
+      return false;
+    }
+    const auto *slots = (const Slot *) (mapping_ + header.slots_offset);
+    uint64_t items = 0;
+    for (uint64_t i = 0; i < slot_count; i++)
+    {
+      const Slot &slot = slots[i];
+      if (slot.key_offset == FROZEN_EMPTY_SLOT)
+      {
+        continue;
+      }
+      if (!in_blob (slot.key_offset, slot.key_length)
+          || !in_blob (slot.value_offset, slot.value_length))
+      {
+        return false;
+      }
+      items++;
+    }
+    return items == header.size;
+  }
+
+  /**
+   * @param offset the offset of bytes in the blob.
+   * @param length the number of bytes.
+   * @return true if the bytes lie in the blob, false otherwise.
+   */
+  bool in_blob (uint64_t offset, uint64_t length) const
+  {
+    return offset <= header_->blob_size
+           && length <= header_->blob_size - offset;
+  }
+
+  /**
+   * This function looks for the slot of a key.
+   * @param key
+   * @return pointer to the slot of the key, or nullptr.
+   */
+  const Slot *find_slot (std::string_view key) const
+  {
+    uint64_t key_hash = hash (key);
+    uint64_t mask = header_->slot_count - 1;
+    uint64_t index = key_hash & mask;
+    for (uint64_t probes = 0; probes < header_->slot_count;
+         probes++, index = (index + 1) & mask)
+    {
+      const Slot &slot = slots_[index];
+      if (slot.key_offset == FROZEN_EMPTY_SLOT)
+      {
+        return nullptr;
+      }
+      if (slot.hash == key_hash && slot.key_length == key.size ()
+          && std::memcmp (blob_ + slot.key_offset, key.data (),
+                          key.size ()) == 0)
+      {
+        return &slot;
+      }
+    }
+    return nullptr;
+  }
+};
+
+#endif //_FROZENDICTIONARY_HPP_
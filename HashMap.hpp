@@ -2,17 +2,116 @@
 #define _HASHMAP_HPP_
 
 #include <vector>
+#include <algorithm>
 #include <stdexcept>
+#include <utility>
+#include <functional>
+#include <tuple>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <limits>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <iterator>
+#include "Parallel.hpp"
+#include "Snapshot.hpp"
 
 #define DEFAULT_CAPACITY 16
 #define MAX_LOAD_FACTOR 0.75
 #define MIN_LOAD_FACTOR 0.25
 #define INITIAL_INT 0
 #define RESIZE_FACTOR 2
+#define MAX_CAPACITY (1 << 30)
+#define INCREMENTAL_RESIZE_STEP 8
+#define PARALLEL_BULK_LOAD_MIN_ITEMS 100000
+#define BULK_LOAD_PARTITIONS 4096
+#define PARALLEL_REHASH_MIN_BUCKETS 65536
+#define BATCH_LOOKUP_GROUP 32
 #define MESSAGE_KEY_NOT_FOUND "Key not found"
 #define MESSAGE_UNMATCHED_SIZE "Keys and values are not of the same size"
+#define MESSAGE_INVALID_POLICY "Invalid resize policy"
 
-template<typename KeyT, typename ValueT>
+#if defined(__GNUC__)
+#define HASHMAP_PREFETCH(address) __builtin_prefetch (address)
+#else
+#define HASHMAP_PREFETCH(address) ((void) (address))
+#endif
+
+/**
+ * The rules by which a HashMap grows and shrinks. The default policy is the
+ * classic one: grow past MAX_LOAD_FACTOR, shrink as soon as the load factor
+ * drops below MIN_LOAD_FACTOR, and drop the capacity to 1 when the last
+ * item is erased.
+ */
+struct ResizePolicy
+{
+  // The map grows when an insert would pass this load factor.
+  double max_load_factor = MAX_LOAD_FACTOR;
+  // The map may shrink when an erase drops the load factor below this one.
+  // It must be smaller than max_load_factor / RESIZE_FACTOR, so that a
+  // resize never leaves the map right at the other threshold.
+  double min_load_factor = MIN_LOAD_FACTOR;
+  // The capacity never drops below this power of two, not even when the
+  // map becomes empty.
+  int min_capacity = 1;
+  // If false, erase never shrinks the map, only shrink_to_fit() does.
+  bool shrink_on_erase = true;
+  // The number of erases in a row that must leave the load factor below
+  // min_load_factor before the map shrinks. An insert that brings the load
+  // factor back up restarts the count.
+  int shrink_delay = 0;
+};
+
+/**
+ * Tells which type a key of type K is looked up as, in a HashMap whose keys
+ * are of type KeyT, without building a KeyT from it. It has a member type
+ * only for the pairs of types for which such a lookup is supported.
+ */
+template<typename KeyT, typename K, typename = void>
+struct transparent_key
+{
+};
+
+/**
+ * std::string keys can be looked up by anything that converts to
+ * std::string_view, such as string_view slices and const char*. This works
+ * because std::hash gives a std::string_view and a std::string with the same
+ * characters the same hash.
+ */
+template<typename K>
+struct transparent_key<
+    std::string, K,
+    typename std::enable_if<
+        std::is_convertible<const K &, std::string_view>::value
+        && !std::is_same<typename std::decay<K>::type, std::string>::value
+    >::type>
+{
+  typedef std::string_view type;
+};
+
+/**
+ * A hash map of buckets, each a vector of entries. The bucket of a key is
+ * chosen by the low bits of its Hash, so a Hash whose low bits are poor,
+ * such as std::hash of integers in libstdc++, which is the integer itself,
+ * puts keys with a common stride into few buckets; see Hashers.hpp for
+ * hashers that mix all their bits. Keys are compared with KeyEqual. With
+ * the default Hash and KeyEqual, the transparent lookups (see
+ * transparent_key) use std::hash and operator== of the lookup type. Other
+ * ones are called with the lookup type if they take it, and otherwise with
+ * a KeyT built from it.
+ * All the memory of the map, the table of buckets and the entries of the
+ * buckets, comes from the Allocator, which is rebound to the types it
+ * allocates. As in the standard containers, the allocator is for
+ * std::pair<const KeyT, ValueT>, and keys and values that allocate memory
+ * of their own keep their own allocators.
+ */
+template<typename KeyT, typename ValueT,
+    typename Hash = std::hash<KeyT>,
+    typename KeyEqual = std::equal_to<KeyT>,
+    typename Allocator = std::allocator<std::pair<const KeyT, ValueT>>>
 class HashMap
 {
 
@@ -22,54 +121,140 @@ class HashMap
 
  public:
   typedef IteratorConst<const std::pair<KeyT, ValueT>> Iterator;
+  typedef Hash hasher;
+  typedef KeyEqual key_equal;
+  typedef Allocator allocator_type;
 
   /**
    * Default constructor
    */
-  HashMap ()
+  HashMap () : HashMap (Allocator ())
+  {
+  }
+
+  /**
+   * A constructor of an empty hash map that uses the given allocator.
+   * @param allocator the allocator.
+   */
+  explicit HashMap (const Allocator &allocator)
+      : HashMap (Hash (), KeyEqual (), allocator)
+  {
+  }
+
+  /**
+   * A constructor of an empty hash map that uses the given hasher and key
+   * comparison.
+   * @param hash the hasher.
+   * @param key_equal the key comparison.
+   * @param allocator the allocator.
+   */
+  HashMap (const Hash &hash, const KeyEqual &key_equal,
+           const Allocator &allocator = Allocator ())
+      : allocator_ (allocator), hash_ (hash), key_equal_ (key_equal)
   {
     size_ = INITIAL_INT;
     capacity_ = DEFAULT_CAPACITY;
     load_factor_ = INITIAL_INT;
-    hash_table_ = new bucket[capacity_];
+    hash_table_ = allocate_table (capacity_);
+    table_size_ = capacity_;
   }
 
   /**
 *    Constructor that takes two vectors of the same size and
-*    creates a hash map.
+*    creates a hash map. For a key that appears more than once, the last
+*    value is kept. The table is sized once for all the keys, and the keys
+*    and values are moved out of the given vectors, so pass them with
+*    std::move to avoid copying them. Large inputs are loaded by several
+*    threads (see bulk_load); the result is the same as loading them on one.
    * @param keys vector of keys
    * @param values vector of values
+   * @param threads the number of threads to load with. By default, all the
+   * hardware threads are used for inputs of PARALLEL_BULK_LOAD_MIN_ITEMS
+   * items or more, and one thread for smaller ones. An allocator with state
+   * is always used from one thread (see allocator_threads).
+   * @param allocator the allocator.
    */
-  HashMap (const std::vector<KeyT> keys, const std::vector<ValueT> values)
+  HashMap (std::vector<KeyT> keys, std::vector<ValueT> values,
+           int threads = 0, const Allocator &allocator = Allocator ())
+      : allocator_ (allocator)
   {
     if (keys.size () != values.size ())
     {
       throw std::invalid_argument (MESSAGE_UNMATCHED_SIZE);
     }
     size_ = INITIAL_INT;
-    capacity_ = DEFAULT_CAPACITY;
+    capacity_ = std::max (DEFAULT_CAPACITY, capacity_for ((int) keys.size ()));
     load_factor_ = INITIAL_INT;
-    hash_table_ = new std::vector<std::pair<KeyT, ValueT>>[capacity_];
-    for (unsigned long i = 0; i < keys.size (); ++i)
+    hash_table_ = allocate_table (capacity_);
+    table_size_ = capacity_;
+    if (threads <= 0)
+    {
+      threads = keys.size () >= PARALLEL_BULK_LOAD_MIN_ITEMS
+                ? hardware_threads () : 1;
+    }
+    threads = allocator_threads (threads);
+    if (threads > 1)
+    {
+      bulk_load (keys, values, threads);
+    }
+    else
+    {
+      for (unsigned long i = 0; i < keys.size (); ++i)
+      {
+        insert_or_assign (std::move (keys[i]), std::move (values[i]));
+      }
+    }
+    // Duplicate keys may leave the table larger than inserting the keys one
+    // by one would have.
+    int final_capacity = std::max (DEFAULT_CAPACITY, capacity_for (size_));
+    if (final_capacity < capacity_)
     {
-      this->operator[] (keys[i]) = values[i];
+      rehash_to (final_capacity, threads);
     }
   }
 
   /**
-   * Copy constructor
+   * Copy constructor. The copy gets the allocator that the allocator of the
+   * other hash map selects for copies.
    * @param other the other hash map.
    */
   HashMap (const HashMap &other)
+      : HashMap (other, std::allocator_traits<Allocator>::
+  select_on_container_copy_construction (other.allocator_))
+  {
+  }
+
+  /**
+   * A copy constructor that uses the given allocator.
+   * @param other the other hash map.
+   * @param allocator the allocator.
+   */
+  HashMap (const HashMap &other, const Allocator &allocator)
+      : allocator_ (allocator), hash_ (other.hash_),
+        key_equal_ (other.key_equal_)
   {
     size_ = other.size_;
     capacity_ = other.capacity_;
     load_factor_ = other.load_factor_;
-    hash_table_ = new bucket[capacity_];
+    incremental_resize_ = other.incremental_resize_;
+    rehash_threads_ = other.rehash_threads_;
+    policy_ = other.policy_;
+    hash_table_ = allocate_table (capacity_);
+    table_size_ = capacity_;
     for (int i = 0; i < capacity_; i++)
     {
       hash_table_[i] = other.hash_table_[i];
     }
+    // The copy does not inherit a resize in progress: the items that were
+    // not migrated yet are copied straight into the new table.
+    for (int i = other.migrated_; other.old_table_ != nullptr
+                                  && i < other.old_capacity_; i++)
+    {
+      for (const auto &entry: other.old_table_[i])
+      {
+        hash_table_[entry.hash & (capacity_ - 1)].push_back (entry);
+      }
+    }
   }
 
   /**
@@ -77,7 +262,8 @@ class HashMap
    */
   virtual ~HashMap ()
   {
-    delete[] hash_table_;
+    free_table (hash_table_, table_size_);
+    free_table (old_table_, old_table_size_);
   }
 
   /**
@@ -113,43 +299,222 @@ class HashMap
    * @param value
    * @return true if the key-value pair is inserted, false otherwise.
    */
-  bool insert (const KeyT key, const ValueT value)
+  bool insert (const KeyT &key, const ValueT &value)
+  {
+    return try_emplace (key, value);
+  }
+
+  /**
+   * This method insert a key-value pair into the hash map. The key and the
+   * value are moved into the hash map.
+   * @param key
+   * @param value
+   * @return true if the key-value pair is inserted, false otherwise.
+   */
+  bool insert (KeyT &&key, ValueT &&value)
+  {
+    return try_emplace (std::move (key), std::move (value));
+  }
+
+  /**
+   * This method constructs an item from the given arguments, and inserts it
+   * if its key is not in the hash map yet. The item is built before the
+   * lookup, so prefer try_emplace when the key is at hand.
+   * @param args the arguments of the constructor of the key-value pair.
+   * @return true if the item is inserted, false otherwise.
+   */
+  template<class... Args>
+  bool emplace (Args &&... args)
   {
-    size_t hash = std::hash<KeyT>{} (key) & (capacity_ - 1);
-    for (size_t i = 0; i < hash_table_[hash].size (); i++)
+    Pair item (std::forward<Args> (args)...);
+    size_t key_hash = hash_key (item.first);
+    if (find_entry (item.first, key_hash) != nullptr)
     {
-      if (hash_table_[hash][i].first == key)
-      {
-        return false;
-      }
+      return false;
     }
-    hash_table_[hash].push_back (std::make_pair (key, value));
-    size_++;
-    load_factor_ = (double) size_ / capacity_;
-    if (load_factor_ > MAX_LOAD_FACTOR)
+    insert_entry (std::move (item), key_hash);
+    return true;
+  }
+
+  /**
+   * This method inserts a key with a value that is constructed in place
+   * from the given arguments. If the key is already in the hash map,
+   * nothing is constructed and the arguments are not moved from.
+   * @param key
+   * @param args the arguments of the constructor of the value.
+   * @return true if the key-value pair is inserted, false otherwise.
+   */
+  template<class... Args>
+  bool try_emplace (const KeyT &key, Args &&... args)
+  {
+    size_t key_hash = hash_key (key);
+    if (find_entry (key, key_hash) != nullptr)
     {
-      resize (true);
-      load_factor_ = (double) size_ / capacity_;
+      return false;
     }
+    insert_entry (Pair (std::piecewise_construct, std::forward_as_tuple (key),
+                        std::forward_as_tuple (std::forward<Args> (args)...)),
+                  key_hash);
     return true;
   }
 
   /**
-   * This method check if a key is in the hash map.
+   * This method is try_emplace for a key that can be moved into the hash
+   * map. The key is moved only if it is inserted.
    * @param key
-   * @return true if the key is in the hash map, false otherwise.
+   * @param args the arguments of the constructor of the value.
+   * @return true if the key-value pair is inserted, false otherwise.
+   */
+  template<class... Args>
+  bool try_emplace (KeyT &&key, Args &&... args)
+  {
+    size_t key_hash = hash_key (key);
+    if (find_entry (key, key_hash) != nullptr)
+    {
+      return false;
+    }
+    insert_entry (Pair (std::piecewise_construct,
+                        std::forward_as_tuple (std::move (key)),
+                        std::forward_as_tuple (std::forward<Args> (args)...)),
+                  key_hash);
+    return true;
+  }
+
+  /**
+   * This method sets the value of a key with a single lookup: the value of
+   * an existing key is replaced, and a missing key is inserted.
+   * @param key
+   * @param value
+   * @return true if the key-value pair is inserted, false if the value of an
+   * existing key was replaced.
+   */
+  template<class V>
+  bool insert_or_assign (const KeyT &key, V &&value)
+  {
+    size_t key_hash = hash_key (key);
+    Entry *entry = find_entry (key, key_hash);
+    if (entry != nullptr)
+    {
+      entry->item.second = std::forward<V> (value);
+      return false;
+    }
+    insert_entry (Pair (key, std::forward<V> (value)), key_hash);
+    return true;
+  }
+
+  /**
+   * This method is insert_or_assign for a key that can be moved into the
+   * hash map. The key is moved only if it is inserted.
+   * @param key
+   * @param value
+   * @return true if the key-value pair is inserted, false if the value of an
+   * existing key was replaced.
+   */
+  template<class V>
+  bool insert_or_assign (KeyT &&key, V &&value)
+  {
+    size_t key_hash = hash_key (key);
+    Entry *entry = find_entry (key, key_hash);
+    if (entry != nullptr)
+    {
+      entry->item.second = std::forward<V> (value);
+      return false;
+    }
+    insert_entry (Pair (std::move (key), std::forward<V> (value)), key_hash);
+    return true;
+  }
+
+  /**
+   * This method get two iterators and it updates the hash map with the
+   * items that are in this range: the value of an existing key is
+   * replaced, and a missing key is added. With move iterators, the values,
+   * and the keys that are added, are moved. For a forward range of items
+   * whose keys are KeyT, the hash map is reserved once for the whole range,
+   * so it does not resize in the middle of it, and the items are taken in
+   * groups: the keys of a group are hashed and their buckets prefetched
+   * before the group is applied, with a single lookup per item. If many of
+   * the keys were already in the hash map, the capacity is brought back to
+   * what the items need afterwards, as in the vectors constructor.
+   * @tparam InputIterator the type of the iterators, over pairs.
+   * @param first The first iterator.
+   * @param last The last iterator.
    */
-  bool contains_key (const KeyT key) const
+  template<class InputIterator>
+  void update (InputIterator first, InputIterator last)
   {
-    size_t hash = std::hash<KeyT>{} (key) & (capacity_ - 1);
-    for (size_t i = 0; i < hash_table_[hash].size (); i++)
+    typedef typename std::iterator_traits<InputIterator>::iterator_category
+        category;
+    typedef typename std::iterator_traits<InputIterator>::value_type item;
+    if constexpr (!std::is_base_of<std::forward_iterator_tag,
+                                   category>::value
+                  || !std::is_same<typename std::remove_const<
+                      typename item::first_type>::type, KeyT>::value)
+    {
+      for (; first != last; ++first)
+      {
+        auto &&pair = *first;
+        insert_or_assign (std::forward<decltype (pair)> (pair).first,
+                          std::forward<decltype (pair)> (pair).second);
+      }
+    }
+    else
     {
-      if (hash_table_[hash][i].first == key)
+      auto count = (size_t) std::distance (first, last);
+      if (count == 0)
+      {
+        return;
+      }
+      int capacity_before = capacity_;
+      reserve ((int) std::min ((size_t) size_ + count,
+                               (size_t) std::numeric_limits<int>::max ()
+                               / RESIZE_FACTOR));
+      size_t hashes[BATCH_LOOKUP_GROUP];
+      while (first != last)
+      {
+        InputIterator group_first = first;
+        size_t group = 0;
+        for (; group < BATCH_LOOKUP_GROUP && first != last; ++first, ++group)
+        {
+          hashes[group] = hash_key ((*first).first);
+          HASHMAP_PREFETCH (&hash_table_[hashes[group] & (capacity_ - 1)]);
+        }
+        for (size_t i = 0; i < group; i++, ++group_first)
+        {
+          auto &&pair = *group_first;
+          assign_entry (std::forward<decltype (pair)> (pair).first,
+                        std::forward<decltype (pair)> (pair).second,
+                        hashes[i]);
+        }
+      }
+      int final_capacity = std::max (capacity_before, capacity_for (size_));
+      if (final_capacity < capacity_)
       {
-        return true;
+        rehash_to (final_capacity);
       }
     }
-    return false;
+  }
+
+  /**
+   * This method check if a key is in the hash map.
+   * @param key
+   * @return true if the key is in the hash map, false otherwise.
+   */
+  bool contains_key (const KeyT &key) const
+  {
+    return find_entry (key, hash_key (key)) != nullptr;
+  }
+
+  /**
+   * This method check if a key is in the hash map, without building a KeyT
+   * from the given key (see transparent_key).
+   * @param key
+   * @return true if the key is in the hash map, false otherwise.
+   */
+  template<class K, class View = typename transparent_key<KeyT, K>::type>
+  bool contains_key (const K &key) const
+  {
+    View view (key);
+    return find_entry (view, hash_key (view)) != nullptr;
   }
 
   /**
@@ -158,17 +523,33 @@ class HashMap
    * @return if the key is in the hash map, return the value of the key,
    * otherwise, throw an exception.
    */
-  ValueT &at (const KeyT key)
+  ValueT &at (const KeyT &key)
   {
-    size_t hash = std::hash<KeyT>{} (key) & (capacity_ - 1);
-    for (size_t i = 0; i < hash_table_[hash].size (); i++)
+    Entry *entry = find_entry (key, hash_key (key));
+    if (entry == nullptr)
     {
-      if (hash_table_[hash][i].first == key)
-      {
-        return hash_table_[hash][i].second;
-      }
+      throw std::out_of_range (MESSAGE_KEY_NOT_FOUND);
+    }
+    return entry->item.second;
+  }
+
+  /**
+   * This method returns the value of a key, without building a KeyT from
+   * the given key (see transparent_key).
+   * @param key
+   * @return if the key is in the hash map, return the value of the key,
+   * otherwise, throw an exception.
+   */
+  template<class K, class View = typename transparent_key<KeyT, K>::type>
+  ValueT &at (const K &key)
+  {
+    View view (key);
+    Entry *entry = find_entry (view, hash_key (view));
+    if (entry == nullptr)
+    {
+      throw std::out_of_range (MESSAGE_KEY_NOT_FOUND);
     }
-    throw std::out_of_range (MESSAGE_KEY_NOT_FOUND);
+    return entry->item.second;
   }
 
   /**
@@ -177,17 +558,104 @@ class HashMap
    * @return if the key is in the hash map, return the value of the key,
    * otherwise, throw an exception.
    */
-  const ValueT &at (const KeyT key) const
+  const ValueT &at (const KeyT &key) const
   {
-    size_t hash = std::hash<KeyT>{} (key) & (capacity_ - 1);
-    for (size_t i = 0; i < hash_table_[hash].size (); i++)
+    const Entry *entry = find_entry (key, hash_key (key));
+    if (entry == nullptr)
     {
-      if (hash_table_[hash][i].first == key)
-      {
-        return hash_table_[hash][i].second;
-      }
+      throw std::out_of_range (MESSAGE_KEY_NOT_FOUND);
+    }
+    return entry->item.second;
+  }
+
+  /**
+   * This method returns the value of a key, without building a KeyT from
+   * the given key (see transparent_key). This method is const.
+   * @param key
+   * @return if the key is in the hash map, return the value of the key,
+   * otherwise, throw an exception.
+   */
+  template<class K, class View = typename transparent_key<KeyT, K>::type>
+  const ValueT &at (const K &key) const
+  {
+    View view (key);
+    const Entry *entry = find_entry (view, hash_key (view));
+    if (entry == nullptr)
+    {
+      throw std::out_of_range (MESSAGE_KEY_NOT_FOUND);
     }
-    throw std::out_of_range (MESSAGE_KEY_NOT_FOUND);
+    return entry->item.second;
+  }
+
+  /**
+   * This method looks for a key with a single hash and a single bucket
+   * scan. Unlike at(), a missing key is not an error.
+   * @param key
+   * @return an iterator to the item of the key if the key is in the hash
+   * map, otherwise, end().
+   */
+  Iterator find (const KeyT &key) const
+  {
+    return find_iterator (key);
+  }
+
+  /**
+   * This method is find() for a key that is looked up without building a
+   * KeyT from it (see transparent_key).
+   * @param key
+   * @return an iterator to the item of the key if the key is in the hash
+   * map, otherwise, end().
+   */
+  template<class K, class View = typename transparent_key<KeyT, K>::type>
+  Iterator find (const K &key) const
+  {
+    return find_iterator (View (key));
+  }
+
+  /**
+   * This method looks up many keys at once. Separate at() calls wait for
+   * the cache misses of every key, on the table and on the bucket, one
+   * after the other. Here the keys are taken in groups: the keys of a group
+   * are all hashed and their buckets prefetched, then the items of the
+   * buckets are prefetched, and only then are the keys looked up, so the
+   * misses of the keys of a group overlap.
+   * @param keys the keys.
+   * @param out set to one pointer per key: to the value of the key, or
+   * nullptr if the key is not in the hash map. The pointers are valid until
+   * the hash map is changed.
+   * @return the number of keys that were found.
+   */
+  size_t find_batch (const std::vector<KeyT> &keys,
+                     std::vector<const ValueT *> &out) const
+  {
+    out.resize (keys.size ());
+    size_t found = 0;
+    lookup_batch (keys.data (), keys.size (), [&] (size_t i, Entry *entry)
+    {
+      out[i] = entry != nullptr ? &entry->item.second : nullptr;
+      found += entry != nullptr;
+    });
+    return found;
+  }
+
+  /**
+   * This method checks if many keys are in the hash map, with the prefetches
+   * of find_batch().
+   * @param keys the keys.
+   * @param out set to one flag per key: true if the key is in the hash map.
+   * @return the number of keys that were found.
+   */
+  size_t contains_batch (const std::vector<KeyT> &keys,
+                         std::vector<bool> &out) const
+  {
+    out.resize (keys.size ());
+    size_t found = 0;
+    lookup_batch (keys.data (), keys.size (), [&] (size_t i, Entry *entry)
+    {
+      out[i] = entry != nullptr;
+      found += entry != nullptr;
+    });
+    return found;
   }
 
   /**
@@ -196,41 +664,178 @@ class HashMap
    * @return if the key is in the hash map, erase the key-value pair and
    * return true, otherwise, return false.
    */
-  virtual bool erase (const KeyT key)
+  virtual bool erase (const KeyT &key)
+  {
+    if (empty ())
+    {
+      return false;
+    }
+    return erase_entry (key, hash_key (key));
+  }
+
+  /**
+   * This method erase a key-value pair from the hash map, without building
+   * a KeyT from the given key (see transparent_key). Unlike erase(const
+   * KeyT &), this method is not virtual, so a class that overrides erase
+   * should hide this overload as well.
+   * @param key
+   * @return if the key is in the hash map, erase the key-value pair and
+   * return true, otherwise, return false.
+   */
+  template<class K, class View = typename transparent_key<KeyT, K>::type>
+  bool erase (const K &key)
   {
-    bool found = false;
     if (empty ())
     {
       return false;
     }
-    size_t hash = std::hash<KeyT>{} (key) & (capacity_ - 1);
-    for (size_t i = 0; i < hash_table_[hash].size (); i++)
+    View view (key);
+    return erase_entry (view, hash_key (view));
+  }
+
+  /**
+   * This method erases every item for which a predicate holds, in a single
+   * pass over the buckets: every bucket is compacted in place, without
+   * looking any key up again. The hash map is then shrunk at most once, to
+   * where erasing the items one by one under the resize policy would have
+   * taken it.
+   * @tparam Predicate a callable that takes a const std::pair<KeyT, ValueT> &
+   * and returns bool.
+   * @param predicate the predicate. With more than one thread, it is called
+   * from several threads at once.
+   * @param threads the number of threads that split the buckets between
+   * them, 0 for all the hardware threads.
+   * @return the number of items that were erased.
+   */
+  template<class Predicate>
+  int erase_if (Predicate predicate, int threads = 1)
+  {
+    finish_migration ();
+    threads = threads > 0 ? threads : hardware_threads ();
+    std::vector<int> erased (threads, 0);
+    parallel_for (capacity_, threads,
+                  [&] (int worker, size_t begin, size_t end)
+                  {
+                    int count = 0;
+                    for (size_t i = begin; i < end; i++)
+                    {
+                      bucket &items = hash_table_[i];
+                      auto kept = std::remove_if (
+                          items.begin (), items.end (),
+                          [&predicate] (const Entry &entry)
+                          { return predicate (entry.item); });
+                      count += (int) (items.end () - kept);
+                      items.erase (kept, items.end ());
+                    }
+                    erased[worker] = count;
+                  });
+    int removed = INITIAL_INT;
+    for (int count: erased)
     {
-      if (hash_table_[hash][i].first == key)
-      {
-        hash_table_[hash][i] = hash_table_[hash][hash_table_[hash].size ()
-                                                 - 1];
-        hash_table_[hash].pop_back ();
-        size_ -= 1;
-        load_factor_ = (double) size_ / capacity_;
-        found = true;
-        if (empty ())
-        {
-          this->capacity_ = 1;
-          return true;
-        }
-      }
+      removed += count;
     }
-    if (found)
+    size_ -= removed;
+    load_factor_ = (double) size_ / capacity_;
+    if (removed == INITIAL_INT || !policy_.shrink_on_erase
+        || load_factor_ >= policy_.min_load_factor)
     {
-      if (load_factor_ < MIN_LOAD_FACTOR)
-      {
-        resize (false);
-        load_factor_ = (double) size_ / capacity_;
-      }
-      return true;
+      return removed;
+    }
+    erases_below_min_ += removed;
+    if (erases_below_min_ <= policy_.shrink_delay)
+    {
+      return removed;
+    }
+    erases_below_min_ = INITIAL_INT;
+    if (empty ())
+    {
+      // The table is not reallocated, only its first buckets are used.
+      capacity_ = policy_.min_capacity;
+      return removed;
+    }
+    int new_capacity = capacity_;
+    while ((double) size_ / new_capacity < policy_.min_load_factor
+           && new_capacity / RESIZE_FACTOR >= policy_.min_capacity)
+    {
+      new_capacity /= RESIZE_FACTOR;
+    }
+    if (new_capacity != capacity_)
+    {
+      rehash_to (new_capacity);
+    }
+    return removed;
+  }
+
+  /**
+   * This method calls a function with every item, on several threads that
+   * split the buckets between them. The hash map must not be changed until
+   * it returns.
+   * @tparam Function a callable that takes a const std::pair<KeyT, ValueT> &.
+   * It is called from several threads at once.
+   * @param function the function.
+   * @param threads the number of threads, 0 for all the hardware threads.
+   */
+  template<class Function>
+  void parallel_for_each (Function function, int threads = 0) const
+  {
+    threads = threads > 0 ? threads : hardware_threads ();
+    parallel_for (bucket_count (), threads,
+                  [&] (int, size_t begin, size_t end)
+                  {
+                    for (size_t i = begin; i < end; i++)
+                    {
+                      for (const auto &entry: bucket_at ((int) i))
+                      {
+                        function (entry.item);
+                      }
+                    }
+                  });
+  }
+
+  /**
+   * This method maps every item to a value and combines the values, on
+   * several threads that split the buckets between them. Every thread
+   * combines the values of its own buckets, starting from the identity, and
+   * the results of the threads are then combined in order. The hash map
+   * must not be changed until it returns.
+   * @tparam T the type of the result.
+   * @tparam Map a callable that takes a const std::pair<KeyT, ValueT> & and
+   * returns a T. It is called from several threads at once.
+   * @tparam Reduce a callable that takes two T and returns their combination.
+   * It must be associative.
+   * @param identity the neutral value of reduce, such as 0 for a sum.
+   * @param map the map function.
+   * @param reduce the reduce function.
+   * @param threads the number of threads, 0 for all the hardware threads.
+   * @return the combination of the values of all the items, or the identity
+   * if the hash map is empty.
+   */
+  template<class T, class Map, class Reduce>
+  T parallel_reduce (T identity, Map map, Reduce reduce, int threads = 0) const
+  {
+    threads = threads > 0 ? threads : hardware_threads ();
+    std::vector<T> partials (threads, identity);
+    int workers = parallel_for (bucket_count (), threads,
+                                [&] (int worker, size_t begin, size_t end)
+                                {
+                                  T partial = identity;
+                                  for (size_t i = begin; i < end; i++)
+                                  {
+                                    for (const auto &entry:
+                                        bucket_at ((int) i))
+                                    {
+                                      partial = reduce (partial,
+                                                        map (entry.item));
+                                    }
+                                  }
+                                  partials[worker] = std::move (partial);
+                                });
+    T result = identity;
+    for (int worker = 0; worker < workers; worker++)
+    {
+      result = reduce (result, partials[worker]);
     }
-    return false;
+    return result;
   }
 
   /**
@@ -247,27 +852,30 @@ class HashMap
    * @param key
    * @return size of the bucket at the given key.
    */
-  int bucket_size (const KeyT key) const
+  int bucket_size (const KeyT &key) const
   {
-    size_t hash = std::hash<KeyT>{} (key) & (capacity_ - 1);
-    if (contains_key (key))
+    Location location = locate (key, hash_key (key));
+    if (location.items != nullptr)
     {
-      return hash_table_[hash].size ();
+      return location.items->size ();
     }
     throw std::invalid_argument (MESSAGE_KEY_NOT_FOUND);
   }
 
   /**
-   * This method returns the index of the bucket at the given key.
+   * This method returns the index of the bucket at the given key. While an
+   * incremental resize is in progress, a key that was not migrated yet
+   * reports its bucket in the old table.
    * @param key
    * @return the index of the bucket at the given key.
    */
-  int bucket_index (const KeyT key) const
+  int bucket_index (const KeyT &key) const
   {
-    size_t hash = std::hash<KeyT>{} (key) & (capacity_ - 1);
-    if (contains_key (key))
+    Location location = locate (key, hash_key (key));
+    if (location.items != nullptr)
     {
-      return (int) hash;
+      return location.bucket_index < capacity_
+             ? location.bucket_index : location.bucket_index - capacity_;
     }
     throw std::invalid_argument (MESSAGE_KEY_NOT_FOUND);
   }
@@ -277,22 +885,100 @@ class HashMap
    */
   void clear ()
   {
-    delete[] hash_table_;
+    free_table (old_table_, old_table_size_);
+    old_table_ = nullptr;
+    free_table (hash_table_, table_size_);
     size_ = INITIAL_INT;
     load_factor_ = INITIAL_INT;
-    hash_table_ = new std::vector<std::pair<KeyT, ValueT>>[capacity_];
+    hash_table_ = allocate_table (capacity_);
+    table_size_ = capacity_;
+  }
+
+  /**
+   * This method returns the allocator of the hash map.
+   * @return a copy of the allocator.
+   */
+  Allocator get_allocator () const
+  {
+    return allocator_;
+  }
+
+  /**
+   * This method returns the hasher of the hash map.
+   * @return a copy of the hasher.
+   */
+  Hash hash_function () const
+  {
+    return hash_;
+  }
+
+  /**
+   * This method returns the key comparison of the hash map.
+   * @return a copy of the key comparison.
+   */
+  KeyEqual key_eq () const
+  {
+    return key_equal_;
   }
 
  protected:
   typedef std::pair<KeyT, ValueT> Pair;
-  typedef std::vector<Pair> bucket;
+
+  /**
+   * An item of the hash map together with the full hash of its key. The hash
+   * is computed once on insert, so resize only masks it again, and a bucket
+   * scan compares keys only when the hashes are equal.
+   */
+  struct Entry
+  {
+    Pair item;
+    size_t hash;
+  };
+
+  typedef typename std::allocator_traits<Allocator>::template
+  rebind_alloc<Entry> EntryAllocator;
+  typedef std::vector<Entry, EntryAllocator> bucket;
+  typedef typename std::allocator_traits<Allocator>::template
+  rebind_alloc<bucket> BucketAllocator;
+
+  Allocator allocator_;
+  Hash hash_;
+  KeyEqual key_equal_;
   int capacity_;
   int size_;
   double load_factor_;
   bucket *hash_table_;
+  // The number of buckets hash_table_ was allocated with. It may be more
+  // than capacity_, which drops without a new table when the map empties.
+  int table_size_ = INITIAL_INT;
+
+  // The state of an incremental resize. While old_table_ is not null, the
+  // buckets of old_table_ from migrated_ on still hold items that were not
+  // moved into hash_table_ yet.
+  ResizePolicy policy_;
+  int erases_below_min_ = INITIAL_INT;
+  bool incremental_resize_ = false;
+  bucket *old_table_ = nullptr;
+  int old_capacity_ = INITIAL_INT;
+  int old_table_size_ = INITIAL_INT;
+  int migrated_ = INITIAL_INT;
+  // The number of threads that rehash_to uses for large tables.
+  int rehash_threads_ = 1;
 
   /**
-   * This is nested class for iterator.
+   * The position of an item: its bucket, the index of the bucket, and the
+   * index of the item in the bucket. Buckets of the old table of an
+   * incremental resize are numbered from capacity_ on.
+   */
+  struct Location
+  {
+    bucket *items;
+    int bucket_index;
+    int element_index;
+  };
+
+  /**
+   * This is nested class for iterator.
    */
   template<class Pair>
   class IteratorConst
@@ -308,33 +994,45 @@ class HashMap
     /**
      * This is the default constructor.
      */
-    explicit IteratorConst (const HashMap<KeyT, ValueT> &hash_map,
+    explicit IteratorConst (const HashMap &hash_map,
                             bool end = false) : hash_map_ (hash_map)
     {
       if (end)
       {
-        bucket_index_ = hash_map_.capacity_;
+        bucket_index_ = hash_map_.bucket_count ();
         bucket_element_index_ = INITIAL_INT;
       }
       else
       {
         bucket_index_ = INITIAL_INT;
         bucket_element_index_ = INITIAL_INT;
-        while (bucket_index_ < hash_map_.capacity_
-               && hash_map_.hash_table_[bucket_index_].empty ())
+        while (bucket_index_ < hash_map_.bucket_count ()
+               && hash_map_.bucket_at (bucket_index_).empty ())
         {
           bucket_index_ += 1;
         }
       }
     }
 
+    /**
+     * This constructor points the iterator at a given item.
+     * @param bucket_index the index of the bucket of the item.
+     * @param bucket_element_index the index of the item in its bucket.
+     */
+    IteratorConst (const HashMap &hash_map, int bucket_index,
+                   int bucket_element_index)
+        : hash_map_ (hash_map), bucket_index_ (bucket_index),
+          bucket_element_index_ (bucket_element_index)
+    {
+    }
+
     /**
      * This is operator*. It returns the value of the iterator.
      * @return
      */
     value_type &operator* () const
     {
-      return hash_map_.hash_table_[bucket_index_][bucket_element_index_];
+      return hash_map_.bucket_at (bucket_index_)[bucket_element_index_].item;
     }
 
     /**
@@ -343,7 +1041,8 @@ class HashMap
      */
     pointer operator-> () const
     {
-      return &hash_map_.hash_table_[bucket_index_][bucket_element_index_];
+      return &hash_map_.bucket_at (bucket_index_)[bucket_element_index_]
+          .item;
     }
 
     /**
@@ -354,11 +1053,11 @@ class HashMap
     {
       bucket_element_index_ += 1;
       if ((unsigned long) bucket_element_index_
-          == hash_map_.hash_table_[bucket_index_].size ())
+          == hash_map_.bucket_at (bucket_index_).size ())
       {
         bucket_index_ += 1;
-        while (bucket_index_ < hash_map_.capacity_
-               && hash_map_.hash_table_[bucket_index_].empty ())
+        while (bucket_index_ < hash_map_.bucket_count ()
+               && hash_map_.bucket_at (bucket_index_).empty ())
         {
           bucket_index_ += 1;
         }
@@ -458,16 +1157,37 @@ class HashMap
     std::swap (size_, other.size_);
     std::swap (load_factor_, other.load_factor_);
     std::swap (hash_table_, other.hash_table_);
+    std::swap (table_size_, other.table_size_);
+    std::swap (old_table_size_, other.old_table_size_);
+    if constexpr (std::allocator_traits<Allocator>::
+                  propagate_on_container_swap::value)
+    {
+      std::swap (allocator_, other.allocator_);
+    }
+    std::swap (hash_, other.hash_);
+    std::swap (key_equal_, other.key_equal_);
+    std::swap (policy_, other.policy_);
+    std::swap (erases_below_min_, other.erases_below_min_);
+    std::swap (incremental_resize_, other.incremental_resize_);
+    std::swap (old_table_, other.old_table_);
+    std::swap (old_capacity_, other.old_capacity_);
+    std::swap (migrated_, other.migrated_);
+    std::swap (rehash_threads_, other.rehash_threads_);
   }
 
   /**
-   * This is assignment operator. It assigns the other hash map to this.
+   * This is assignment operator. It assigns the other hash map to this. The
+   * items are copied with the allocator of this hash map, which is kept.
    * @param other the other hash map.
    * @return the reference to this hash map.
    */
-  HashMap &operator= (HashMap other)
+  HashMap &operator= (const HashMap &other)
   {
-    swap (other);
+    if (this != &other)
+    {
+      HashMap copy (other, allocator_);
+      swap (copy);
+    }
     return *this;
   }
 
@@ -478,15 +1198,30 @@ class HashMap
    */
   ValueT &operator[] (const KeyT &key)
   {
-    if (contains_key (key))
+    size_t key_hash = hash_key (key);
+    Entry *entry = find_entry (key, key_hash);
+    if (entry == nullptr)
     {
-      return at (key);
+      entry = &insert_entry (Pair (key, ValueT ()), key_hash);
     }
-    else
+    return entry->item.second;
+  }
+
+  /**
+   * This is operator[] for a key that can be moved into the hash map. The
+   * key is moved only if it is inserted.
+   * @param key the key.
+   * @return the value of the key.
+   */
+  ValueT &operator[] (KeyT &&key)
+  {
+    size_t key_hash = hash_key (key);
+    Entry *entry = find_entry (key, key_hash);
+    if (entry == nullptr)
     {
-      insert (key, ValueT ());
-      return at (key);
+      entry = &insert_entry (Pair (std::move (key), ValueT ()), key_hash);
     }
+    return entry->item.second;
   }
 
   /**
@@ -496,14 +1231,12 @@ class HashMap
    */
   const ValueT &operator[] (const KeyT &key) const
   {
-    if (contains_key (key))
-    {
-      return at (key);
-    }
-    else
+    const Entry *entry = find_entry (key, hash_key (key));
+    if (entry == nullptr)
     {
       return DEFAULT_VALUE;
     }
+    return entry->item.second;
   }
 
   /**
@@ -514,25 +1247,20 @@ class HashMap
    */
   bool operator== (const HashMap &other) const
   {
-    try
+    if (size_ != other.size_)
+    {
+      return false;
+    }
+    for (auto it = cbegin (); it != cend (); ++it)
     {
-      if (size_ != other.size_)
+      const Entry *entry = other.find_entry (it->first,
+                                             other.hash_key (it->first));
+      if (entry == nullptr || entry->item.second != it->second)
       {
         return false;
       }
-      for (auto it = cbegin (); it != cend (); ++it)
-      {
-        if (other.at (it->first) != it->second)
-        {
-          return false;
-        }
-      }
-      return true;
-    }
-    catch (std::out_of_range &error_msg)
-    {
-      return false;
     }
+    return true;
   }
 
   /**
@@ -546,7 +1274,9 @@ class HashMap
   }
 
   /**
-   * Thus function resizes the hash map.
+   * Thus function resizes the hash map. With incremental resizing on, it
+   * only allocates the new table, and the items are migrated a few buckets
+   * at a time by the following inserts and erases.
    * @param is_up is boolean value. If it is true, it increases the size of
    * the hash map, otherwise, it decreases the size of the hash map.
    */
@@ -561,22 +1291,837 @@ class HashMap
     {
       new_capacity /= RESIZE_FACTOR;
     }
-    auto *new_hash_table = new bucket[new_capacity];
-    for (int i = 0; i < capacity_; ++i)
+    if (incremental_resize_)
+    {
+      start_migration (new_capacity);
+    }
+    else
+    {
+      rehash_to (new_capacity);
+    }
+  }
+
+  /**
+   * This function turns incremental resizing on or off. With it on, a
+   * resize triggered by insert or erase does not move all the items at
+   * once: every following insert and erase migrates INCREMENTAL_RESIZE_STEP
+   * buckets of the old table, and lookups consult both tables until the
+   * migration is done. This bounds the cost of a single insert at the price
+   * of slightly slower lookups during a migration. Turning it off finishes
+   * any migration in progress.
+   * @param enabled true to resize incrementally, false to resize at once.
+   */
+  void set_incremental_resize (bool enabled)
+  {
+    incremental_resize_ = enabled;
+    if (!enabled)
+    {
+      finish_migration ();
+    }
+  }
+
+  /**
+   * This function sets the number of threads that move the items when the
+   * table is rehashed at once: on growth, and by reserve(), rehash() and
+   * shrink_to_fit(). Threads are only used when the larger of the two tables
+   * has at least PARALLEL_REHASH_MIN_BUCKETS buckets; smaller tables are
+   * rehashed on the calling thread. The result does not depend on the number
+   * of threads.
+   * @param threads the number of threads, 0 for all the hardware threads.
+   */
+  void set_rehash_threads (int threads)
+  {
+    rehash_threads_ = threads > 0 ? threads : hardware_threads ();
+  }
+
+  /**
+   * This method check if an incremental resize is in progress.
+   * @return true if some items were not migrated to the new table yet.
+   */
+  bool resizing () const
+  {
+    return old_table_ != nullptr;
+  }
+
+  /**
+   * This function makes room for the given number of items, so that
+   * inserting them does not resize the hash map. It never decreases the
+   * capacity.
+   * @param items the number of items the hash map should hold.
+   */
+  void reserve (int items)
+  {
+    int new_capacity = capacity_for (items);
+    if (new_capacity > capacity_)
+    {
+      rehash_to (new_capacity);
+    }
+  }
+
+  /**
+   * This function sets the capacity of the hash map to the smallest power
+   * of two that is at least the given number of buckets and keeps the
+   * current items below the max load factor. It may decrease the capacity.
+   * @param buckets the minimal number of buckets.
+   */
+  void rehash (int buckets)
+  {
+    int new_capacity = capacity_for (size_);
+    while (new_capacity < buckets)
+    {
+      new_capacity *= RESIZE_FACTOR;
+    }
+    if (new_capacity != capacity_)
+    {
+      rehash_to (new_capacity);
+    }
+  }
+
+  /**
+   * This function shrinks the hash map to the smallest capacity that holds
+   * its items under the resize policy. Use it with a policy that does not
+   * shrink on erase.
+   */
+  void shrink_to_fit ()
+  {
+    int new_capacity = capacity_for (size_);
+    if (new_capacity < capacity_)
+    {
+      rehash_to (new_capacity);
+    }
+  }
+
+  /**
+   * This method returns the resize policy of the hash map.
+   * @return the resize policy.
+   */
+  const ResizePolicy &get_resize_policy () const
+  {
+    return policy_;
+  }
+
+  /**
+   * This function sets the resize policy of the hash map. If the current
+   * capacity does not fit the new policy, the hash map grows right away; it
+   * never shrinks here.
+   * @param policy the new policy.
+   */
+  void set_resize_policy (const ResizePolicy &policy)
+  {
+    bool power_of_two = policy.min_capacity > 0
+                        && (policy.min_capacity & (policy.min_capacity - 1))
+                           == 0;
+    if (!power_of_two || policy.max_load_factor <= 0
+        || policy.min_load_factor < 0
+        || policy.min_load_factor >= policy.max_load_factor / RESIZE_FACTOR
+        || policy.shrink_delay < 0)
+    {
+      throw std::invalid_argument (MESSAGE_INVALID_POLICY);
+    }
+    policy_ = policy;
+    erases_below_min_ = INITIAL_INT;
+    reserve (size_);
+  }
+
+  /**
+   * This method writes the hash map to a snapshot file: a header with the
+   * capacity and the size, and then every key and value (see snapshot_io),
+   * bucket by bucket, through a large buffer. KeyT and ValueT must be
+   * trivially copyable or std::string.
+   * @param path the path of the file. An existing file is replaced.
+   */
+  void save (const std::string &path) const
+  {
+    SnapshotWriter writer (path);
+    SnapshotHeader header {};
+    std::memcpy (header.magic, SNAPSHOT_MAGIC, sizeof (SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.key_size = snapshot_io<KeyT>::size;
+    header.value_size = snapshot_io<ValueT>::size;
+    header.capacity = (uint64_t) capacity_;
+    header.size = (uint64_t) size_;
+    writer.put (&header, sizeof (header));
+    for (int i = 0; i < bucket_count (); i++)
     {
-      for (auto &item: hash_table_[i])
+      for (const auto &entry: bucket_at (i))
       {
-        int hash_num = std::hash<KeyT>{} (item.first) & (new_capacity - 1);
-        new_hash_table[hash_num].push_back (item);
+        snapshot_io<KeyT>::write (writer, entry.item.first);
+        snapshot_io<ValueT>::write (writer, entry.item.second);
       }
     }
-    delete[] hash_table_;
-    hash_table_ = new_hash_table;
-    capacity_ = new_capacity;
+    writer.close ();
+  }
+
+  /**
+   * This method replaces the items of the hash map with the items of a
+   * snapshot file written by save(). The table is allocated once with the
+   * stored capacity, and the items are added without looking them up, since
+   * the keys of a snapshot are distinct. The hash function, the key
+   * comparison and the resize policy are kept.
+   * @param path the path of the file.
+   */
+  void load (const std::string &path)
+  {
+    SnapshotReader reader (path);
+    SnapshotHeader header {};
+    reader.get (&header, sizeof (header));
+    uint64_t capacity = header.capacity;
+    if (std::memcmp (header.magic, SNAPSHOT_MAGIC, sizeof (SNAPSHOT_MAGIC))
+        != 0 || header.version != SNAPSHOT_VERSION
+        || header.key_size != snapshot_io<KeyT>::size
+        || header.value_size != snapshot_io<ValueT>::size
+        || capacity == 0 || (capacity & (capacity - 1)) != 0
+        || capacity > (uint64_t) std::numeric_limits<int>::max ())
+    {
+      throw std::runtime_error (MESSAGE_SNAPSHOT_INVALID);
+    }
+    HashMap loaded (hash_, key_equal_, allocator_);
+    loaded.free_table (loaded.hash_table_, loaded.table_size_);
+    loaded.hash_table_ = loaded.allocate_table ((int) capacity);
+    loaded.table_size_ = (int) capacity;
+    loaded.capacity_ = (int) capacity;
+    loaded.policy_ = policy_;
+    loaded.incremental_resize_ = incremental_resize_;
+    loaded.rehash_threads_ = rehash_threads_;
+    for (uint64_t i = 0; i < header.size; i++)
+    {
+      Pair item;
+      snapshot_io<KeyT>::read (reader, item.first);
+      snapshot_io<ValueT>::read (reader, item.second);
+      size_t key_hash = hash_key (item.first);
+      loaded.hash_table_[key_hash & (capacity - 1)].push_back (
+          Entry {std::move (item), key_hash});
+    }
+    loaded.size_ = (int) header.size;
+    loaded.load_factor_ = (double) loaded.size_ / loaded.capacity_;
+    swap (loaded);
   }
 
  private:
   ValueT DEFAULT_VALUE;
 
+ protected:
+
+  /**
+   * This function hashes a key.
+   * @tparam LookupT KeyT, or the type of a transparent lookup key.
+   * @param key
+   * @return the full hash of the key.
+   */
+  template<class LookupT>
+  size_t hash_key (const LookupT &key) const
+  {
+    if constexpr (std::is_same<Hash, std::hash<KeyT>>::value)
+    {
+      return std::hash<LookupT>{} (key);
+    }
+    else if constexpr (std::is_invocable<const Hash &, const LookupT &>::value)
+    {
+      return hash_ (key);
+    }
+    else
+    {
+      return hash_ (KeyT (key));
+    }
+  }
+
+  /**
+   * This function checks if an entry holds the given key. The cached hashes
+   * are compared first, so most mismatches never compare the keys.
+   * @param entry the entry.
+   * @param key the key.
+   * @param key_hash the full hash of the key.
+   * @return true if the entry holds the key, false otherwise.
+   */
+  template<class LookupT>
+  bool matches (const Entry &entry, const LookupT &key, size_t key_hash) const
+  {
+    if constexpr (std::is_same<KeyEqual, std::equal_to<KeyT>>::value)
+    {
+      return entry.hash == key_hash && entry.item.first == key;
+    }
+    else if constexpr (std::is_invocable<const KeyEqual &, const KeyT &,
+                                         const LookupT &>::value)
+    {
+      return entry.hash == key_hash && key_equal_ (entry.item.first, key);
+    }
+    else
+    {
+      return entry.hash == key_hash && key_equal_ (entry.item.first,
+                                                   KeyT (key));
+    }
+  }
+
+  /**
+   * This function computes the capacity that is needed for a number of
+   * items.
+   * @param items the number of items.
+   * @return the smallest power of two that holds the items without passing
+   * the max load factor of the policy, and is not below its min capacity,
+   * but not more than MAX_CAPACITY.
+   */
+  int capacity_for (int items) const
+  {
+    int capacity = policy_.min_capacity;
+    while ((double) items / capacity > policy_.max_load_factor
+           && capacity < MAX_CAPACITY)
+    {
+      capacity *= RESIZE_FACTOR;
+    }
+    return capacity;
+  }
+
+  /**
+   * This function moves all the items into a new table of buckets. The
+   * cached hashes are only masked again, and the entries are moved, not
+   * copied.
+   * @param new_capacity the number of buckets of the new table, a power of
+   * two.
+   */
+  void rehash_to (int new_capacity)
+  {
+    rehash_to (new_capacity, rehash_threads_);
+  }
+
+  /**
+   * This function moves all the items into a new table of buckets, with
+   * several threads if the tables are large enough. Since both capacities
+   * are powers of two, the items of old bucket i can only go to new buckets
+   * that are equal to i modulo the smaller capacity. On growth the workers
+   * split the old buckets, and on shrink they split the new buckets, so
+   * every new bucket is written by a single worker, and gets its items in
+   * the same order as on one thread.
+   * @param new_capacity the number of buckets of the new table, a power of
+   * two.
+   * @param threads the number of threads.
+   */
+  void rehash_to (int new_capacity, int threads)
+  {
+    finish_migration ();
+    threads = allocator_threads (threads);
+    bucket *new_hash_table = allocate_table (new_capacity);
+    if (threads > 1
+        && std::max (capacity_, new_capacity) >= PARALLEL_REHASH_MIN_BUCKETS)
+    {
+      bool grow = new_capacity >= capacity_;
+      int step = std::min (capacity_, new_capacity);
+      parallel_for (grow ? capacity_ : new_capacity, threads,
+                    [&] (int, size_t begin, size_t end)
+                    {
+                      for (size_t j = begin; j < end; j++)
+                      {
+                        // On growth j is an old bucket. On shrink it is a
+                        // new bucket, filled from old buckets j, j + step...
+                        int last = grow ? (int) j + 1 : capacity_;
+                        for (int i = (int) j; i < last; i += step)
+                        {
+                          for (auto &entry: hash_table_[i])
+                          {
+                            new_hash_table[entry.hash & (new_capacity - 1)]
+                                .push_back (std::move (entry));
+                          }
+                          // Free the old bucket here, in parallel, rather
+                          // than in free_table below.
+                          bucket (EntryAllocator (allocator_)).swap (
+                              hash_table_[i]);
+                        }
+                      }
+                    });
+    }
+    else
+    {
+      for (int i = 0; i < capacity_; ++i)
+      {
+        for (auto &entry: hash_table_[i])
+        {
+          int hash_num = entry.hash & (new_capacity - 1);
+          new_hash_table[hash_num].push_back (std::move (entry));
+        }
+      }
+    }
+    free_table (hash_table_, table_size_);
+    hash_table_ = new_hash_table;
+    table_size_ = new_capacity;
+    capacity_ = new_capacity;
+    load_factor_ = (double) size_ / capacity_;
+  }
+
+  /**
+   * This function loads items into an empty table that is large enough for
+   * all of them, with several threads. The keys are hashed in parallel, and
+   * the items are then partitioned by a counting sort into ranges of
+   * consecutive buckets, keeping their order. Every thread then fills the
+   * buckets of its own ranges, so no two threads touch the same bucket. The
+   * items of a bucket are added in input order, so for a key that appears
+   * more than once the last value is kept, and the table ends up the same as
+   * after inserting the items one by one.
+   * @param keys the keys. They are moved out of the vector.
+   * @param values the values. They are moved out of the vector.
+   * @param threads the number of threads.
+   */
+  void bulk_load (std::vector<KeyT> &keys, std::vector<ValueT> &values,
+                  int threads)
+  {
+    size_t items = keys.size ();
+    std::vector<size_t> hashes (items);
+    parallel_for (items, threads, [&] (int, size_t begin, size_t end)
+    {
+      for (size_t i = begin; i < end; i++)
+      {
+        hashes[i] = hash_key (keys[i]);
+      }
+    });
+
+    // Partition p holds the buckets whose index is p << shift and up.
+    int partitions = std::min (capacity_, BULK_LOAD_PARTITIONS);
+    int shift = 0;
+    while ((partitions << shift) < capacity_)
+    {
+      shift++;
+    }
+    size_t mask = capacity_ - 1;
+    std::vector<std::vector<size_t>> offsets (
+        threads, std::vector<size_t> (partitions, 0));
+    int workers = parallel_for (items, threads,
+                                [&] (int worker, size_t begin, size_t end)
+                                {
+                                  auto &counts = offsets[worker];
+                                  for (size_t i = begin; i < end; i++)
+                                  {
+                                    counts[(hashes[i] & mask) >> shift]++;
+                                  }
+                                });
+    // Turn the counts into the position of the first item of every worker
+    // in every partition: partitions in order, and workers in order within.
+    std::vector<size_t> starts (partitions + 1);
+    size_t position = 0;
+    for (int p = 0; p < partitions; p++)
+    {
+      starts[p] = position;
+      for (int worker = 0; worker < workers; worker++)
+      {
+        size_t count = offsets[worker][p];
+        offsets[worker][p] = position;
+        position += count;
+      }
+    }
+    starts[partitions] = position;
+    std::vector<size_t> order (items);
+    parallel_for (items, threads, [&] (int worker, size_t begin, size_t end)
+    {
+      auto &next = offsets[worker];
+      for (size_t i = begin; i < end; i++)
+      {
+        order[next[(hashes[i] & mask) >> shift]++] = i;
+      }
+    });
+
+    std::vector<int> added (threads, 0);
+    parallel_for (partitions, threads,
+                  [&] (int worker, size_t begin, size_t end)
+                  {
+                    int count = 0;
+                    for (size_t k = starts[begin]; k < starts[end]; k++)
+                    {
+                      size_t i = order[k];
+                      bucket &destination = hash_table_[hashes[i] & mask];
+                      Entry *entry = nullptr;
+                      for (auto &other: destination)
+                      {
+                        if (matches (other, keys[i], hashes[i]))
+                        {
+                          entry = &other;
+                          break;
+                        }
+                      }
+                      if (entry != nullptr)
+                      {
+                        entry->item.second = std::move (values[i]);
+                        continue;
+                      }
+                      destination.push_back (
+                          Entry {Pair (std::move (keys[i]),
+                                       std::move (values[i])), hashes[i]});
+                      count++;
+                    }
+                    added[worker] = count;
+                  });
+    for (int count: added)
+    {
+      size_ += count;
+    }
+    load_factor_ = (double) size_ / capacity_;
+  }
+
+  /**
+   * This function looks for the item of a key.
+   * @param key the key.
+   * @return an iterator to the item of the key, or end().
+   */
+  template<class LookupT>
+  Iterator find_iterator (const LookupT &key) const
+  {
+    Location location = locate (key, hash_key (key));
+    if (location.items == nullptr)
+    {
+      return end ();
+    }
+    return IteratorConst<const Pair> (*this, location.bucket_index,
+                                      location.element_index);
+  }
+
+  /**
+   * This function finds the position of the item of a key. During an
+   * incremental resize the key is looked up in the new table, and then in
+   * the old table if its bucket there was not migrated yet.
+   * @param key the key.
+   * @param key_hash the full hash of the key.
+   * @return the location of the item, with null items if the key is not in
+   * the hash map.
+   */
+  template<class LookupT>
+  Location locate (const LookupT &key, size_t key_hash) const
+  {
+    int index = (int) (key_hash & (capacity_ - 1));
+    bucket *items = &hash_table_[index];
+    for (size_t i = 0; i < items->size (); i++)
+    {
+      if (matches ((*items)[i], key, key_hash))
+      {
+        return Location {items, index, (int) i};
+      }
+    }
+    if (old_table_ != nullptr)
+    {
+      index = (int) (key_hash & (old_capacity_ - 1));
+      items = &old_table_[index];
+      for (size_t i = 0; index >= migrated_ && i < items->size (); i++)
+      {
+        if (matches ((*items)[i], key, key_hash))
+        {
+          return Location {items, capacity_ + index, (int) i};
+        }
+      }
+    }
+    return Location {nullptr, -1, -1};
+  }
+
+  /**
+   * This function looks for the entry of a key.
+   * @param key the key.
+   * @param key_hash the full hash of the key.
+   * @return pointer to the entry of the key, or nullptr if the key is not
+   * in the hash map.
+   */
+  template<class LookupT>
+  Entry *find_entry (const LookupT &key, size_t key_hash) const
+  {
+    Location location = locate (key, key_hash);
+    if (location.items == nullptr)
+    {
+      return nullptr;
+    }
+    return &(*location.items)[location.element_index];
+  }
+
+  /**
+   * This function looks up keys in groups of BATCH_LOOKUP_GROUP, with
+   * three passes over every group: hash the keys and prefetch their
+   * buckets, prefetch the items of the buckets, and look the keys up.
+   * During an incremental resize only the new table is prefetched.
+   * @tparam Function a callable that takes (size_t index, Entry *entry),
+   * with a null entry for a key that is not in the hash map.
+   * @param keys the keys.
+   * @param count the number of keys.
+   * @param function the function, called for the keys in order.
+   */
+  template<class LookupT, class Function>
+  void lookup_batch (const LookupT *keys, size_t count,
+                     Function function) const
+  {
+    size_t hashes[BATCH_LOOKUP_GROUP];
+    for (size_t begin = 0; begin < count; begin += BATCH_LOOKUP_GROUP)
+    {
+      size_t group = std::min ((size_t) BATCH_LOOKUP_GROUP, count - begin);
+      for (size_t i = 0; i < group; i++)
+      {
+        hashes[i] = hash_key (keys[begin + i]);
+        HASHMAP_PREFETCH (&hash_table_[hashes[i] & (capacity_ - 1)]);
+      }
+      for (size_t i = 0; i < group; i++)
+      {
+        const bucket &items = hash_table_[hashes[i] & (capacity_ - 1)];
+        if (!items.empty ())
+        {
+          HASHMAP_PREFETCH (items.data ());
+        }
+      }
+      for (size_t i = 0; i < group; i++)
+      {
+        function (begin + i, find_entry (keys[begin + i], hashes[i]));
+      }
+    }
+  }
+
+  /**
+   * This function sets the value of a key whose hash is known: the value of
+   * an existing key is replaced, and a missing key is inserted.
+   * @param key the key. It is moved only if it is inserted.
+   * @param value the value.
+   * @param key_hash the full hash of the key.
+   * @return true if the key-value pair is inserted, false if the value of an
+   * existing key was replaced.
+   */
+  template<class K, class V>
+  bool assign_entry (K &&key, V &&value, size_t key_hash)
+  {
+    Entry *entry = find_entry (key, key_hash);
+    if (entry != nullptr)
+    {
+      entry->item.second = std::forward<V> (value);
+      return false;
+    }
+    insert_entry (Pair (std::forward<K> (key), std::forward<V> (value)),
+                  key_hash);
+    return true;
+  }
+
+  /**
+   * This function adds an item whose key is not in the hash map. If the
+   * new item would pass the max load factor, the hash map is resized
+   * before the item is added, so the returned reference stays valid.
+   * @param item the item.
+   * @param key_hash the full hash of the key of the item.
+   * @return reference to the entry of the new item.
+   */
+  Entry &insert_entry (Pair &&item, size_t key_hash)
+  {
+    migrate_step ();
+    if ((double) (size_ + 1) / capacity_ > policy_.max_load_factor)
+    {
+      resize (true);
+    }
+    bucket &items = hash_table_[key_hash & (capacity_ - 1)];
+    items.push_back (Entry {std::move (item), key_hash});
+    size_++;
+    load_factor_ = (double) size_ / capacity_;
+    if (load_factor_ >= policy_.min_load_factor)
+    {
+      erases_below_min_ = INITIAL_INT;
+    }
+    return items.back ();
+  }
+
+  /**
+   * This function erases the entry of a key, and shrinks the hash map if
+   * the resize policy says so. When the last item is erased, the capacity
+   * drops to the min capacity of the policy (1 by default).
+   * @param key the key.
+   * @param key_hash the full hash of the key.
+   * @return true if the key was erased, false if it is not in the hash map.
+   */
+  template<class LookupT>
+  bool erase_entry (const LookupT &key, size_t key_hash)
+  {
+    migrate_step ();
+    Location location = locate (key, key_hash);
+    if (location.items == nullptr)
+    {
+      return false;
+    }
+    bucket &items = *location.items;
+    if ((size_t) location.element_index + 1 != items.size ())
+    {
+      items[location.element_index] = std::move (items.back ());
+    }
+    items.pop_back ();
+    size_ -= 1;
+    load_factor_ = (double) size_ / capacity_;
+    if (empty ())
+    {
+      // Nothing is left to migrate.
+      free_table (old_table_, old_table_size_);
+      old_table_ = nullptr;
+    }
+    if (!should_shrink ())
+    {
+      return true;
+    }
+    if (empty ())
+    {
+      // The table is not reallocated, only its first buckets are used.
+      this->capacity_ = policy_.min_capacity;
+    }
+    else if (capacity_ / RESIZE_FACTOR >= policy_.min_capacity)
+    {
+      resize (false);
+      load_factor_ = (double) size_ / capacity_;
+    }
+    return true;
+  }
+
+  /**
+   * This function decides, after an erase, if the hash map should shrink.
+   * @return true if the load factor is below the min load factor, and it
+   * has been for the number of erases the policy asks for.
+   */
+  bool should_shrink ()
+  {
+    if (!policy_.shrink_on_erase || load_factor_ >= policy_.min_load_factor)
+    {
+      return false;
+    }
+    erases_below_min_++;
+    if (erases_below_min_ <= policy_.shrink_delay)
+    {
+      return false;
+    }
+    erases_below_min_ = INITIAL_INT;
+    return true;
+  }
+
+  /**
+   * @return the number of buckets the iterators walk: the buckets of the
+   * table, followed by the buckets of the old table during an incremental
+   * resize.
+   */
+  int bucket_count () const
+  {
+    return old_table_ == nullptr ? capacity_ : capacity_ + old_capacity_;
+  }
+
+  /**
+   * @param index index of a bucket, smaller than bucket_count().
+   * @return the bucket at the given index.
+   */
+  const bucket &bucket_at (int index) const
+  {
+    return index < capacity_ ? hash_table_[index]
+                             : old_table_[index - capacity_];
+  }
+
+  /**
+   * This function starts an incremental resize: the current table becomes
+   * the old table, and an empty table of the new capacity takes its place.
+   * A resize that is still in progress is finished first.
+   * @param new_capacity the capacity of the new table.
+   */
+  void start_migration (int new_capacity)
+  {
+    finish_migration ();
+    old_table_ = hash_table_;
+    old_capacity_ = capacity_;
+    old_table_size_ = table_size_;
+    migrated_ = INITIAL_INT;
+    hash_table_ = allocate_table (new_capacity);
+    table_size_ = new_capacity;
+    capacity_ = new_capacity;
+  }
+
+  /**
+   * This function moves the items of a few buckets of the old table into
+   * the new table, and frees the old table once all of it was migrated.
+   * @param buckets the number of buckets of the old table to migrate.
+   */
+  void migrate_step (int buckets = INCREMENTAL_RESIZE_STEP)
+  {
+    if (old_table_ == nullptr)
+    {
+      return;
+    }
+    for (; buckets > 0 && migrated_ < old_capacity_; buckets--, migrated_++)
+    {
+      for (auto &entry: old_table_[migrated_])
+      {
+        hash_table_[entry.hash & (capacity_ - 1)].push_back (
+            std::move (entry));
+      }
+      bucket (EntryAllocator (allocator_)).swap (old_table_[migrated_]);
+    }
+    if (migrated_ == old_capacity_)
+    {
+      free_table (old_table_, old_table_size_);
+      old_table_ = nullptr;
+    }
+  }
+
+  /**
+   * This function migrates all the items that are left in the old table of
+   * an incremental resize.
+   */
+  void finish_migration ()
+  {
+    if (old_table_ != nullptr)
+    {
+      migrate_step (old_capacity_);
+    }
+  }
+
+  /**
+   * This function returns the number of threads that may allocate from the
+   * allocator at once. Instances of an allocator that are not always equal
+   * may share state, such as the memory resource of the polymorphic
+   * allocator of pmr::HashMap, which need not be thread-safe, so such an
+   * allocator is only used from one thread.
+   * @param threads the number of threads that were asked for.
+   * @return threads, or 1 for an allocator that is not always equal.
+   */
+  static int allocator_threads (int threads)
+  {
+    return std::allocator_traits<Allocator>::is_always_equal::value
+           ? threads : 1;
+  }
+
+  /**
+   * This function allocates a table of empty buckets with the allocator.
+   * @param buckets the number of buckets.
+   * @return the table. table_size_ is not set.
+   */
+  bucket *allocate_table (int buckets)
+  {
+    BucketAllocator bucket_allocator (allocator_);
+    bucket *table = std::allocator_traits<BucketAllocator>::allocate (
+        bucket_allocator, buckets);
+    for (int i = 0; i < buckets; i++)
+    {
+      ::new ((void *) (table + i)) bucket (EntryAllocator (allocator_));
+    }
+    return table;
+  }
+
+  /**
+   * This function destroys the buckets of a table and frees it with the
+   * allocator.
+   * @param table the table, or nullptr.
+   * @param buckets the number of buckets it was allocated with.
+   */
+  void free_table (bucket *table, int buckets)
+  {
+    if (table == nullptr)
+    {
+      return;
+    }
+    for (int i = 0; i < buckets; i++)
+    {
+      table[i].~bucket ();
+    }
+    BucketAllocator bucket_allocator (allocator_);
+    std::allocator_traits<BucketAllocator>::deallocate (bucket_allocator,
+                                                        table, buckets);
+  }
 };
+
+namespace pmr
+{
+/**
+ * A hash map that takes its memory from a std::pmr::memory_resource, such
+ * as a std::pmr::monotonic_buffer_resource that frees it all at once.
+ */
+template<typename KeyT, typename ValueT,
+    typename Hash = std::hash<KeyT>,
+    typename KeyEqual = std::equal_to<KeyT>>
+using HashMap = ::HashMap<KeyT, ValueT, Hash, KeyEqual,
+                          std::pmr::polymorphic_allocator<
+                              std::pair<const KeyT, ValueT>>>;
+}
 #endif //_HASHMAP_HPP_
\ No newline at end of file
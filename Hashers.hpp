@@ -0,0 +1,197 @@
+#ifndef _HASHERS_HPP_
+#define _HASHERS_HPP_
+
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+#define WYHASH_SECRET_0 0xa0761d6478bd642fULL
+#define WYHASH_SECRET_1 0xe7037ed1a0b428dbULL
+#define WYHASH_SECRET_2 0x8ebc6af09c88c6e3ULL
+#define WYHASH_SECRET_3 0x589965cc75374cc3ULL
+#define FIBONACCI_MULTIPLIER 0x9E3779B97F4A7C15ULL
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+/**
+ * This function hashes a string with 64-bit FNV-1a, which does not depend
+ * on the standard library, so it can be stored in files, and can run at
+ * compile time.
+ * @param key the string.
+ * @return the hash of the string.
+ */
+constexpr uint64_t fnv1a (std::string_view key)
+{
+  uint64_t result = FNV_OFFSET_BASIS;
+  for (char c: key)
+  {
+    result = (result ^ (unsigned char) c) * FNV_PRIME;
+  }
+  return result;
+}
+
+/**
+ * This function multiplies two 64-bit numbers into 128 bits, and folds the
+ * high half into the low half, so every bit of the result depends on every
+ * bit of the numbers.
+ * @param a the first number.
+ * @param b the second number.
+ * @return the low half of the product xor its high half.
+ */
+inline uint64_t multiply_fold (uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+  unsigned __int128 product = (unsigned __int128) a * b;
+  return (uint64_t) product ^ (uint64_t) (product >> 64);
+#else
+  uint64_t a_high = a >> 32, a_low = (uint32_t) a;
+  uint64_t b_high = b >> 32, b_low = (uint32_t) b;
+  uint64_t high_high = a_high * b_high, high_low = a_high * b_low;
+  uint64_t low_high = a_low * b_high, low_low = a_low * b_low;
+  uint64_t middle = high_low + (low_low >> 32) + (uint32_t) low_high;
+  uint64_t high = high_high + (middle >> 32) + (low_high >> 32);
+  uint64_t low = (middle << 32) | (uint32_t) low_low;
+  return low ^ high;
+#endif
+}
+
+/**
+ * A fast hash of strings in the style of wyhash: the string is read 8 or 16
+ * bytes at a time, and every 16 bytes cost one 64x64->128-bit multiply,
+ * instead of the byte-at-a-time loop of std::hash. It also takes
+ * std::string_view and const char*, so a HashMap with std::string keys and
+ * this hasher keeps its transparent lookups.
+ */
+struct FastStringHash
+{
+  size_t operator() (std::string_view key) const noexcept
+  {
+    return (size_t) hash (key.data (), key.size ());
+  }
+
+  size_t operator() (const std::string &key) const noexcept
+  {
+    return (size_t) hash (key.data (), key.size ());
+  }
+
+  size_t operator() (const char *key) const noexcept
+  {
+    return (size_t) hash (key, std::strlen (key));
+  }
+
+  /**
+   * This function hashes bytes.
+   * @param data the bytes.
+   * @param length the number of bytes.
+   * @param seed the seed.
+   * @return the hash of the bytes.
+   */
+  static uint64_t hash (const char *data, size_t length, uint64_t seed = 0)
+  {
+    const auto *p = (const unsigned char *) data;
+    seed ^= multiply_fold (seed ^ WYHASH_SECRET_0, WYHASH_SECRET_1);
+    uint64_t a, b;
+    if (length <= 16)
+    {
+      if (length >= 4)
+      {
+        size_t shift = (length >> 3) << 2;
+        a = (read32 (p) << 32) | read32 (p + shift);
+        b = (read32 (p + length - 4) << 32) | read32 (p + length - 4 - shift);
+      }
+      else if (length > 0)
+      {
+        // The first, middle and last bytes.
+        a = ((uint64_t) p[0] << 16) | ((uint64_t) p[length >> 1] << 8)
+            | p[length - 1];
+        b = 0;
+      }
+      else
+      {
+        a = b = 0;
+      }
+    }
+    else
+    {
+      size_t left = length;
+      if (left > 48)
+      {
+        uint64_t lane1 = seed, lane2 = seed;
+        do
+        {
+          seed = multiply_fold (read64 (p) ^ WYHASH_SECRET_1,
+                                read64 (p + 8) ^ seed);
+          lane1 = multiply_fold (read64 (p + 16) ^ WYHASH_SECRET_2,
+                                 read64 (p + 24) ^ lane1);
+          lane2 = multiply_fold (read64 (p + 32) ^ WYHASH_SECRET_3,
+                                 read64 (p + 40) ^ lane2);
+          p += 48;
+          left -= 48;
+        }
+        while (left > 48);
+        seed ^= lane1 ^ lane2;
+      }
+      while (left > 16)
+      {
+        seed = multiply_fold (read64 (p) ^ WYHASH_SECRET_1,
+                              read64 (p + 8) ^ seed);
+        p += 16;
+        left -= 16;
+      }
+      // The last 16 bytes, which may overlap the bytes that were read.
+      a = read64 (p + left - 16);
+      b = read64 (p + left - 8);
+    }
+    return multiply_fold (WYHASH_SECRET_1 ^ length,
+                          multiply_fold (a ^ WYHASH_SECRET_1, b ^ seed));
+  }
+
+ private:
+  static uint64_t read64 (const unsigned char *p)
+  {
+    uint64_t value;
+    std::memcpy (&value, p, sizeof (value));
+    return value;
+  }
+
+  static uint64_t read32 (const unsigned char *p)
+  {
+    uint32_t value;
+    std::memcpy (&value, p, sizeof (value));
+    return value;
+  }
+};
+
+/**
+ * A hash of integers (and enums and pointers) for tables that pick the
+ * bucket by the low bits of the hash: the key is multiplied by 2^64 over
+ * the golden ratio (Fibonacci hashing), and the high half of the 128-bit
+ * product, where the multiply gathers the bits of the key, is folded into
+ * the low half. Keys with a common stride, which std::hash sends to the
+ * same few buckets, are spread over all of them.
+ */
+struct FibonacciHash
+{
+  template<class T>
+  size_t operator() (T key) const noexcept
+  {
+    static_assert (std::is_integral<T>::value || std::is_enum<T>::value
+                   || std::is_pointer<T>::value,
+                   "FibonacciHash hashes integers, enums and pointers");
+    uint64_t bits;
+    if constexpr (std::is_pointer<T>::value)
+    {
+      bits = (uint64_t) (uintptr_t) key;
+    }
+    else
+    {
+      bits = (uint64_t) key;
+    }
+    return (size_t) multiply_fold (bits, FIBONACCI_MULTIPLIER);
+  }
+};
+
+#endif //_HASHERS_HPP_
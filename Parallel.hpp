@@ -0,0 +1,77 @@
+#ifndef _PARALLEL_HPP_
+#define _PARALLEL_HPP_
+
+#include <vector>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <cstddef>
+
+/**
+ * This function returns the number of threads the parallel algorithms use
+ * when they are not told otherwise.
+ * @return the number of hardware threads, at least 1.
+ */
+inline int hardware_threads ()
+{
+  return (int) std::max (1u, std::thread::hardware_concurrency ());
+}
+
+/**
+ * This function splits the range [0, count) into contiguous chunks, one per
+ * worker, and runs a function on every chunk in parallel: fork, then join.
+ * Worker 0 runs on the calling thread. Chunks are ordered: the chunk of
+ * worker t comes right before the chunk of worker t + 1. If a worker throws,
+ * the first exception is thrown again after all the workers are done.
+ * @tparam Function a callable that takes (int worker, size_t begin,
+ * size_t end).
+ * @param count the size of the range.
+ * @param threads the number of workers. It is reduced to count if the range
+ * is smaller.
+ * @param function the function.
+ * @return the number of workers that were used.
+ */
+template<class Function>
+int parallel_for (size_t count, int threads, Function function)
+{
+  threads = (int) std::max ((size_t) 1, std::min ((size_t) threads, count));
+  if (threads == 1)
+  {
+    function (0, (size_t) 0, count);
+    return 1;
+  }
+  std::vector<std::exception_ptr> errors (threads);
+  auto run = [&] (int worker)
+  {
+    try
+    {
+      function (worker, count * worker / threads,
+                count * (worker + 1) / threads);
+    }
+    catch (...)
+    {
+      errors[worker] = std::current_exception ();
+    }
+  };
+  std::vector<std::thread> workers;
+  workers.reserve (threads - 1);
+  for (int worker = 1; worker < threads; worker++)
+  {
+    workers.emplace_back (run, worker);
+  }
+  run (0);
+  for (auto &worker: workers)
+  {
+    worker.join ();
+  }
+  for (auto &error: errors)
+  {
+    if (error)
+    {
+      std::rethrow_exception (error);
+    }
+  }
+  return threads;
+}
+
+#endif //_PARALLEL_HPP_
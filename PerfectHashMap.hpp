@@ -0,0 +1,594 @@
+#ifndef _PERFECTHASHMAP_HPP_
+#define _PERFECTHASHMAP_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <cstdint>
+#include "HashMap.hpp"
+#include "Parallel.hpp"
+
+#define PERFECT_HASH_BUCKET_SIZE 5
+#define PERFECT_HASH_LOAD_FACTOR 0.98
+#define PERFECT_HASH_DENSE_KEYS 0.6
+#define PERFECT_HASH_DENSE_BUCKETS 0.3
+#define PERFECT_HASH_PARTITION_KEYS 100000
+#define PERFECT_HASH_MAX_PILOT (1 << 24)
+#define PERFECT_HASH_SEED 0x5851F42D4C957F2DULL
+#define PERFECT_HASH_BUCKET_SALT 0x9E3779B97F4A7C15ULL
+#define PERFECT_HASH_POSITION_SALT 0xC2B2AE3D27D4EB4FULL
+#define PERFECT_HASH_PILOT_MULTIPLIER 0x9FB21C651E98DF25ULL
+#define BITS_PER_WORD 64
+#define MESSAGE_PERFECT_HASH_COLLISION "Different keys with the same hash"
+#define MESSAGE_PERFECT_HASH_BUILD "Cannot build the perfect hash function"
+
+/**
+ * An immutable hash map over a fixed set of keys, built from a HashMap, in
+ * which every key has a slot of its own: the items are stored in a single
+ * array, and a minimal perfect hash function maps each key straight to the
+ * index of its item. A lookup reads a few bits of metadata, which are small
+ * enough to stay in the cache, and then makes exactly one probe into the
+ * items, where the stored key is compared with the key that is looked up;
+ * a key that is not in the map is found out by that compare.
+ *
+ * The function is built as in PTHash. The keys are split into partitions
+ * of about PERFECT_HASH_PARTITION_KEYS keys, which are built independently
+ * and in parallel. Inside a partition, the keys are hashed into buckets of
+ * PERFECT_HASH_BUCKET_SIZE keys on average (60% of the keys into 30% of the
+ * buckets, so the large buckets are placed while the table is still
+ * empty), and the buckets, largest first, each get the smallest "pilot"
+ * that sends all of their keys to free positions of a table of
+ * keys / PERFECT_HASH_LOAD_FACTOR positions. The few keys that land past
+ * the last item are remapped to the free positions below it. The pilots
+ * are packed with as many bits as the largest of them needs, which comes to
+ * about 3 bits of metadata per key.
+ */
+template<typename KeyT, typename ValueT>
+class PerfectHashMap
+{
+ public:
+  typedef std::pair<KeyT, ValueT> Pair;
+  typedef typename std::vector<Pair>::const_iterator Iterator;
+
+  /**
+   * A constructor that builds the perfect hash map of the items of a hash
+   * map. The hash map must use the default hash and key comparison, which
+   * are the ones the perfect hash map looks keys up with.
+   * @param map the hash map.
+   * @param threads the number of threads that build the partitions, 0 for
+   * all the hardware threads.
+   */
+  template<class Allocator>
+  explicit PerfectHashMap (
+      const HashMap<KeyT, ValueT, std::hash<KeyT>, std::equal_to<KeyT>,
+                    Allocator> &map,
+      int threads = 0)
+  {
+    std::vector<Pair> items;
+    items.reserve (map.size ());
+    for (const auto &item: map)
+    {
+      items.push_back (item);
+    }
+    build (items, threads > 0 ? threads : hardware_threads ());
+  }
+
+  /**
+   * This method returns the number of items.
+   * @return size of the map.
+   */
+  int size () const
+  {
+    return (int) items_.size ();
+  }
+
+  /**
+   * This method check if the map is empty.
+   * @return true if the map is empty, false otherwise.
+   */
+  bool empty () const
+  {
+    return items_.empty ();
+  }
+
+  /**
+   * This method check if a key is in the map.
+   * @param key
+   * @return true if the key is in the map, false otherwise.
+   */
+  bool contains_key (const KeyT &key) const
+  {
+    return find_item (key) != nullptr;
+  }
+
+  /**
+   * This method check if a key is in the map, without building a KeyT from
+   * the given key (see transparent_key).
+   * @param key
+   * @return true if the key is in the map, false otherwise.
+   */
+  template<class K, class View = typename transparent_key<KeyT, K>::type>
+  bool contains_key (const K &key) const
+  {
+    return find_item (View (key)) != nullptr;
+  }
+
+  /**
+   * This method returns the value of a key.
+   * @param key
+   * @return if the key is in the map, return the value of the key,
+   * otherwise, throw an exception.
+   */
+  const ValueT &at (const KeyT &key) const
+  {
+    return value_of (find_item (key));
+  }
+
+  /**
+   * This method returns the value of a key, without building a KeyT from
+   * the given key (see transparent_key).
+   * @param key
+   * @return if the key is in the map, return the value of the key,
+   * otherwise, throw an exception.
+   */
+  template<class K, class View = typename transparent_key<KeyT, K>::type>
+  const ValueT &at (const K &key) const
+  {
+    return value_of (find_item (View (key)));
+  }
+
+  /**
+   * @return an iterator to the first item. The items are in the order of
+   * their slots.
+   */
+  Iterator begin () const
+  {
+    return items_.cbegin ();
+  }
+
+  /**
+   * @return an iterator past the last item.
+   */
+  Iterator end () const
+  {
+    return items_.cend ();
+  }
+
+  /**
+   * @return an iterator to the first item.
+   */
+  Iterator cbegin () const
+  {
+    return items_.cbegin ();
+  }
+
+  /**
+   * @return an iterator past the last item.
+   */
+  Iterator cend () const
+  {
+    return items_.cend ();
+  }
+
+  /**
+   * This method returns the size of the perfect hash function: the pilots,
+   * the remapped positions and the partitions, per key.
+   * @return the number of bits of metadata per key.
+   */
+  double bits_per_key () const
+  {
+    if (items_.empty ())
+    {
+      return 0;
+    }
+    size_t bits = pilots_.size () * BITS_PER_WORD
+                  + remap_.size () * sizeof (uint32_t) * 8
+                  + partitions_.size () * sizeof (Partition) * 8;
+    return (double) bits / items_.size ();
+  }
+
+ private:
+
+  /**
+   * A partition of the keys, with a perfect hash function of its own.
+   */
+  struct Partition
+  {
+    // The slot of the first item of the partition.
+    uint64_t first;
+    // The index of the pilot of the first bucket of the partition.
+    uint64_t pilot_offset;
+    // The index of the remapped position of the first position past the
+    // items of the partition.
+    uint64_t remap_offset;
+    uint32_t keys;
+    uint32_t buckets;
+    // The number of buckets that get the PERFECT_HASH_DENSE_KEYS keys.
+    uint32_t dense_buckets;
+    uint32_t table_size;
+  };
+
+  std::vector<Pair> items_;
+  std::vector<Partition> partitions_;
+  // The pilots of all the buckets, pilot_bits_ bits each.
+  std::vector<uint64_t> pilots_;
+  int pilot_bits_ = 1;
+  // For every position past the items of a partition, the free position
+  // below them that it stands for.
+  std::vector<uint32_t> remap_;
+
+  /**
+   * This function mixes the bits of a number (the splitmix64 finalizer).
+   * @param x the number.
+   * @return the mixed number.
+   */
+  static uint64_t mix (uint64_t x)
+  {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+
+  /**
+   * This function maps a hash into [0, range) by its high bits, without a
+   * division.
+   * @param hash the hash.
+   * @param range the size of the range.
+   * @return a number smaller than range.
+   */
+  static uint64_t reduce (uint64_t hash, uint64_t range)
+  {
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t) (((unsigned __int128) hash * range) >> BITS_PER_WORD);
+#else
+    return hash % range;
+#endif
+  }
+
+  /**
+   * This function hashes a key. The hash picks the partition by its high
+   * bits; the bucket and the position are picked by hashes derived from it.
+   * @param key
+   * @return the hash of the key.
+   */
+  template<class LookupT>
+  static uint64_t hash_key (const LookupT &key)
+  {
+    return mix (std::hash<LookupT>{} (key) ^ PERFECT_HASH_SEED);
+  }
+
+  /**
+   * @param hash the hash of a key.
+   * @param partition the partition of the key.
+   * @return the bucket of the key in its partition.
+   */
+  static uint32_t bucket_of (uint64_t hash, const Partition &partition)
+  {
+    uint64_t bucket_hash = mix (hash ^ PERFECT_HASH_BUCKET_SALT);
+    // The low bits choose between the dense and the sparse buckets, and the
+    // high bits choose the bucket.
+    if ((double) (uint32_t) bucket_hash
+        < PERFECT_HASH_DENSE_KEYS * 4294967296.0)
+    {
+      return (uint32_t) reduce (bucket_hash, partition.dense_buckets);
+    }
+    return partition.dense_buckets + (uint32_t) reduce (
+        bucket_hash, partition.buckets - partition.dense_buckets);
+  }
+
+  /**
+   * @param position_hash the position hash of a key.
+   * @param pilot the pilot of the bucket of the key.
+   * @param partition the partition of the key.
+   * @return the position of the key in the table of its partition.
+   */
+  static uint32_t position_of (uint64_t position_hash, uint64_t pilot,
+                               const Partition &partition)
+  {
+    // The sum is mixed again: with a plain xor, two keys whose hashes
+    // start with the same bits would collide for every pilot.
+    return (uint32_t) reduce (
+        mix (position_hash + pilot * PERFECT_HASH_PILOT_MULTIPLIER),
+        partition.table_size);
+  }
+
+  /**
+   * @param index the index of a bucket among all the buckets.
+   * @return the pilot of the bucket.
+   */
+  uint64_t pilot (uint64_t index) const
+  {
+    uint64_t bit = index * pilot_bits_;
+    uint64_t word = bit / BITS_PER_WORD;
+    int shift = (int) (bit % BITS_PER_WORD);
+    uint64_t value = pilots_[word] >> shift;
+    if (shift + pilot_bits_ > BITS_PER_WORD)
+    {
+      value |= pilots_[word + 1] << (BITS_PER_WORD - shift);
+    }
+    return value & ((~0ULL) >> (BITS_PER_WORD - pilot_bits_));
+  }
+
+  /**
+   * This function looks for the item of a key, with a single probe into
+   * the items.
+   * @param key
+   * @return pointer to the item of the key, or nullptr.
+   */
+  template<class LookupT>
+  const Pair *find_item (const LookupT &key) const
+  {
+    if (items_.empty ())
+    {
+      return nullptr;
+    }
+    uint64_t hash = hash_key (key);
+    const Partition &partition = partitions_[reduce (hash,
+                                                     partitions_.size ())];
+    if (partition.keys == 0)
+    {
+      return nullptr;
+    }
+    uint32_t position = position_of (
+        mix (hash ^ PERFECT_HASH_POSITION_SALT),
+        pilot (partition.pilot_offset + bucket_of (hash, partition)),
+        partition);
+    if (position >= partition.keys)
+    {
+      position = remap_[partition.remap_offset + position - partition.keys];
+    }
+    const Pair &item = items_[partition.first + position];
+    return item.first == key ? &item : nullptr;
+  }
+
+  /**
+   * @param item the item of a key, or nullptr.
+   * @return the value of the item, or throw an exception if there is none.
+   */
+  static const ValueT &value_of (const Pair *item)
+  {
+    if (item == nullptr)
+    {
+      throw std::out_of_range (MESSAGE_KEY_NOT_FOUND);
+    }
+    return item->second;
+  }
+
+  /**
+   * This function builds the perfect hash function of the items, and puts
+   * the items in their slots.
+   * @param items the items. They are moved from.
+   * @param threads the number of threads.
+   */
+  void build (std::vector<Pair> &items, int threads)
+  {
+    size_t count = items.size ();
+    if (count == 0)
+    {
+      pilots_.assign (1, 0);
+      return;
+    }
+    std::vector<uint64_t> hashes (count);
+    parallel_for (count, threads, [&] (int, size_t begin, size_t end)
+    {
+      for (size_t i = begin; i < end; i++)
+      {
+        hashes[i] = hash_key (items[i].first);
+      }
+    });
+
+    // Group the items by partition.
+    size_t partitions = std::max ((size_t) 1,
+                                  count / PERFECT_HASH_PARTITION_KEYS);
+    std::vector<size_t> starts (partitions + 1, 0);
+    for (uint64_t hash: hashes)
+    {
+      starts[reduce (hash, partitions) + 1]++;
+    }
+    for (size_t p = 0; p < partitions; p++)
+    {
+      starts[p + 1] += starts[p];
+    }
+    std::vector<size_t> order (count);
+    std::vector<size_t> next (starts.begin (), starts.end () - 1);
+    for (size_t i = 0; i < count; i++)
+    {
+      order[next[reduce (hashes[i], partitions)]++] = i;
+    }
+
+    partitions_.resize (partitions);
+    uint64_t buckets = 0, remapped = 0;
+    for (size_t p = 0; p < partitions; p++)
+    {
+      Partition &partition = partitions_[p];
+      partition.first = starts[p];
+      partition.keys = (uint32_t) (starts[p + 1] - starts[p]);
+      partition.buckets = std::max (
+          1u, (partition.keys + PERFECT_HASH_BUCKET_SIZE - 1)
+              / PERFECT_HASH_BUCKET_SIZE);
+      partition.dense_buckets = std::max (
+          1u, (uint32_t) (partition.buckets * PERFECT_HASH_DENSE_BUCKETS));
+      partition.dense_buckets = std::min (partition.dense_buckets,
+                                          partition.buckets - 1);
+      partition.table_size = std::max (
+          partition.keys,
+          (uint32_t) (partition.keys / PERFECT_HASH_LOAD_FACTOR) + 1);
+      partition.pilot_offset = buckets;
+      partition.remap_offset = remapped;
+      buckets += partition.buckets;
+      remapped += partition.table_size - partition.keys;
+    }
+
+    // Build the partitions, each into its own ranges of the arrays.
+    std::vector<uint64_t> pilots (buckets);
+    std::vector<size_t> slots (count);
+    remap_.assign (remapped, 0);
+    parallel_for (partitions, threads, [&] (int, size_t begin, size_t end)
+    {
+      for (size_t p = begin; p < end; p++)
+      {
+        build_partition (partitions_[p], hashes, order, pilots, slots);
+      }
+    });
+
+    // Pack the pilots.
+    uint64_t max_pilot = *std::max_element (pilots.begin (), pilots.end ());
+    pilot_bits_ = 1;
+    while (pilot_bits_ < BITS_PER_WORD && (max_pilot >> pilot_bits_) != 0)
+    {
+      pilot_bits_++;
+    }
+    pilots_.assign (buckets * pilot_bits_ / BITS_PER_WORD + 2, 0);
+    for (uint64_t i = 0; i < buckets; i++)
+    {
+      uint64_t bit = i * pilot_bits_;
+      int shift = (int) (bit % BITS_PER_WORD);
+      pilots_[bit / BITS_PER_WORD] |= pilots[i] << shift;
+      if (shift + pilot_bits_ > BITS_PER_WORD)
+      {
+        pilots_[bit / BITS_PER_WORD + 1] |=
+            pilots[i] >> (BITS_PER_WORD - shift);
+      }
+    }
+
+    items_.reserve (count);
+    for (size_t slot = 0; slot < count; slot++)
+    {
+      items_.push_back (std::move (items[slots[slot]]));
+    }
+  }
+
+  /**
+   * This function finds the pilots of the buckets of a partition, and the
+   * slot of every item of the partition.
+   * @param partition the partition.
+   * @param hashes the hashes of the items.
+   * @param order the indices of the items, grouped by partition.
+   * @param pilots set to the pilots of the buckets of the partition.
+   * @param slots set to the index of the item of every slot of the
+   * partition.
+   */
+  void build_partition (const Partition &partition,
+                        const std::vector<uint64_t> &hashes,
+                        const std::vector<size_t> &order,
+                        std::vector<uint64_t> &pilots,
+                        std::vector<size_t> &slots)
+  {
+    if (partition.keys == 0)
+    {
+      return;
+    }
+    // Group the items of the partition by bucket.
+    std::vector<uint32_t> bucket_starts (partition.buckets + 1, 0);
+    std::vector<uint32_t> item_buckets (partition.keys);
+    for (uint32_t i = 0; i < partition.keys; i++)
+    {
+      item_buckets[i] = bucket_of (hashes[order[partition.first + i]],
+                                   partition);
+      bucket_starts[item_buckets[i] + 1]++;
+    }
+    uint32_t largest = 0;
+    for (uint32_t b = 0; b < partition.buckets; b++)
+    {
+      largest = std::max (largest, bucket_starts[b + 1]);
+      bucket_starts[b + 1] += bucket_starts[b];
+    }
+    std::vector<uint64_t> position_hashes (partition.keys);
+    std::vector<size_t> bucket_items (partition.keys);
+    std::vector<uint32_t> next (bucket_starts.begin (),
+                                bucket_starts.end () - 1);
+    for (uint32_t i = 0; i < partition.keys; i++)
+    {
+      size_t item = order[partition.first + i];
+      uint32_t at = next[item_buckets[i]]++;
+      bucket_items[at] = item;
+      position_hashes[at] = mix (hashes[item] ^ PERFECT_HASH_POSITION_SALT);
+    }
+
+    // Place the buckets, largest first.
+    std::vector<std::vector<uint32_t>> by_size (largest + 1);
+    for (uint32_t b = 0; b < partition.buckets; b++)
+    {
+      by_size[bucket_starts[b + 1] - bucket_starts[b]].push_back (b);
+    }
+    std::vector<bool> taken (partition.table_size, false);
+    std::vector<uint32_t> positions (partition.keys);
+    std::vector<uint32_t> candidate (largest);
+    for (uint32_t size = largest; size > 0; size--)
+    {
+      for (uint32_t b: by_size[size])
+      {
+        const uint64_t *keys = &position_hashes[bucket_starts[b]];
+        for (uint32_t i = 1; i < size; i++)
+        {
+          for (uint32_t j = 0; j < i; j++)
+          {
+            if (keys[i] == keys[j])
+            {
+              throw std::invalid_argument (MESSAGE_PERFECT_HASH_COLLISION);
+            }
+          }
+        }
+        uint64_t pilot = 0;
+        for (;; pilot++)
+        {
+          if (pilot == PERFECT_HASH_MAX_PILOT)
+          {
+            throw std::runtime_error (MESSAGE_PERFECT_HASH_BUILD);
+          }
+          uint32_t placed = 0;
+          for (; placed < size; placed++)
+          {
+            uint32_t position = position_of (keys[placed], pilot, partition);
+            if (taken[position]
+                || std::find (candidate.begin (), candidate.begin () + placed,
+                              position) != candidate.begin () + placed)
+            {
+              break;
+            }
+            candidate[placed] = position;
+          }
+          if (placed == size)
+          {
+            break;
+          }
+        }
+        pilots[partition.pilot_offset + b] = pilot;
+        for (uint32_t i = 0; i < size; i++)
+        {
+          taken[candidate[i]] = true;
+          positions[bucket_starts[b] + i] = candidate[i];
+        }
+      }
+    }
+
+    // Send the positions past the items to the free positions below them.
+    uint32_t free_position = 0;
+    for (uint32_t position = partition.keys;
+         position < partition.table_size; position++)
+    {
+      if (taken[position])
+      {
+        while (taken[free_position])
+        {
+          free_position++;
+        }
+        remap_[partition.remap_offset + position - partition.keys] =
+            free_position++;
+      }
+    }
+    for (uint32_t i = 0; i < partition.keys; i++)
+    {
+      uint32_t position = positions[i];
+      if (position >= partition.keys)
+      {
+        position = remap_[partition.remap_offset + position - partition.keys];
+      }
+      slots[partition.first + position] = bucket_items[i];
+    }
+  }
+};
+
+#endif //_PERFECTHASHMAP_HPP_
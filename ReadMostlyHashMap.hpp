@@ -0,0 +1,392 @@
+#ifndef _READMOSTLYHASHMAP_HPP_
+#define _READMOSTLYHASHMAP_HPP_
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <cstdint>
+#include <utility>
+#include "HashMap.hpp"
+#include "CacheLine.hpp"
+
+#define MAX_READER_THREADS 256
+#define INACTIVE_EPOCH 0
+#define MESSAGE_TOO_MANY_READERS "Too many reader threads"
+
+/**
+ * Epoch-based reclamation for read-mostly data. Every reader thread owns a
+ * slot on its own cache line. Before it reads shared data, a reader copies
+ * the global epoch into its slot, and it clears the slot when it is done, so
+ * a read writes only to memory that no other thread writes.
+ * A writer that replaces an object retires the old one with the epoch in
+ * which it was replaced, and advances the global epoch. The old object can
+ * be freed once every active reader has entered at a later epoch: such
+ * readers started after the replacement, and cannot hold the old object.
+ * A single domain is shared by all the read-mostly maps of the process.
+ */
+class EpochDomain
+{
+  struct Slot;
+
+ public:
+
+  /**
+   * @return the domain of the process.
+   */
+  static EpochDomain &instance ()
+  {
+    static EpochDomain domain;
+    return domain;
+  }
+
+  /**
+   * Marks the current thread as reading for the life time of the guard.
+   * Guards may nest; only the outermost one touches the slot.
+   */
+  class ReadGuard
+  {
+   public:
+    /**
+     * Enters a read section.
+     */
+    ReadGuard () : slot_ (instance ().local_slot ())
+    {
+      if (slot_.depth++ == 0)
+      {
+        slot_.epoch.store (instance ().epoch_.load ());
+      }
+    }
+
+    /**
+     * Leaves the read section.
+     */
+    ~ReadGuard ()
+    {
+      if (--slot_.depth == 0)
+      {
+        slot_.epoch.store (INACTIVE_EPOCH);
+      }
+    }
+
+    ReadGuard (const ReadGuard &other) = delete;
+
+    ReadGuard &operator= (const ReadGuard &other) = delete;
+
+   private:
+    Slot &slot_;
+  };
+
+  /**
+   * Advances the global epoch. Call it right after an object was replaced.
+   * @return the epoch in which the object was replaced.
+   */
+  uint64_t advance ()
+  {
+    return epoch_.fetch_add (1);
+  }
+
+  /**
+   * @param retired the epoch in which an object was replaced.
+   * @return true if no reader can hold the object anymore.
+   */
+  bool can_free (uint64_t retired) const
+  {
+    for (const auto &slot: slots_)
+    {
+      uint64_t epoch = slot.epoch.load ();
+      if (epoch != INACTIVE_EPOCH && epoch <= retired)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+
+  /**
+   * The slot of a reader thread.
+   */
+  struct alignas(CACHE_LINE_SIZE) Slot
+  {
+    // The epoch in which the thread entered, or INACTIVE_EPOCH.
+    std::atomic<uint64_t> epoch {INACTIVE_EPOCH};
+    // Whether a thread owns the slot.
+    std::atomic<bool> taken {false};
+    // The number of nested guards of the owner. Only the owner uses it.
+    int depth = 0;
+  };
+
+  /**
+   * Owns a slot for the life time of a thread.
+   */
+  struct SlotOwner
+  {
+    Slot *slot = nullptr;
+
+    /**
+     * Gives the slot back when the thread exits.
+     */
+    ~SlotOwner ()
+    {
+      if (slot != nullptr)
+      {
+        slot->taken.store (false);
+      }
+    }
+  };
+
+  std::atomic<uint64_t> epoch_ {INACTIVE_EPOCH + 1};
+  Slot slots_[MAX_READER_THREADS];
+
+  EpochDomain () = default;
+
+  /**
+   * @return the slot of the current thread. A thread takes a free slot the
+   * first time it reads.
+   */
+  Slot &local_slot ()
+  {
+    static thread_local SlotOwner owner;
+    if (owner.slot != nullptr)
+    {
+      return *owner.slot;
+    }
+    for (auto &slot: slots_)
+    {
+      bool expected = false;
+      if (slot.taken.compare_exchange_strong (expected, true))
+      {
+        owner.slot = &slot;
+        return slot;
+      }
+    }
+    throw std::runtime_error (MESSAGE_TOO_MANY_READERS);
+  }
+};
+
+/**
+ * A hash map for data that is read very often and changed rarely, such as
+ * a dictionary that is reloaded a few times an hour.
+ * The items live in an immutable HashMap snapshot. Lookups take no lock and
+ * write no shared memory: they only load the current snapshot and search
+ * it. A writer copies the snapshot, changes the copy, and publishes it with
+ * a single atomic store; the old snapshot is freed through EpochDomain once
+ * no reader can hold it anymore. Every write therefore costs a copy of the
+ * whole map, so batch changes with modify() or replace the whole map with
+ * assign().
+ */
+template<typename KeyT, typename ValueT>
+class ReadMostlyHashMap
+{
+ public:
+  typedef HashMap<KeyT, ValueT> Snapshot;
+
+  /**
+   * Default constructor
+   */
+  ReadMostlyHashMap () : current_ (new Snapshot ())
+  {
+  }
+
+  /**
+   * A constructor that takes its first snapshot from a HashMap.
+   * @param items the items of the map.
+   */
+  explicit ReadMostlyHashMap (Snapshot items)
+      : current_ (new Snapshot (std::move (items)))
+  {
+  }
+
+  ReadMostlyHashMap (const ReadMostlyHashMap &other) = delete;
+
+  ReadMostlyHashMap &operator= (const ReadMostlyHashMap &other) = delete;
+
+  /**
+   * Destructor. No thread may use the map anymore.
+   */
+  ~ReadMostlyHashMap ()
+  {
+    delete current_.load ();
+    for (auto &retired: retired_)
+    {
+      delete retired.first;
+    }
+  }
+
+  /**
+   * This method looks for a key and copies its value out.
+   * @param key
+   * @param value set to the value of the key, if the key is found.
+   * @return true if the key is in the hash map, false otherwise.
+   */
+  bool find (const KeyT &key, ValueT &value) const
+  {
+    EpochDomain::ReadGuard guard;
+    const Snapshot *snapshot = current_.load ();
+    auto it = snapshot->find (key);
+    if (it == snapshot->end ())
+    {
+      return false;
+    }
+    value = it->second;
+    return true;
+  }
+
+  /**
+   * This method check if a key is in the hash map.
+   * @param key
+   * @return true if the key is in the hash map, false otherwise.
+   */
+  bool contains_key (const KeyT &key) const
+  {
+    EpochDomain::ReadGuard guard;
+    return current_.load ()->contains_key (key);
+  }
+
+  /**
+   * This method calls a function with the current snapshot, for reads that
+   * need more than one lookup to see the same version of the map. The
+   * snapshot must not be used after the function returns.
+   * @tparam Function a callable that takes a const HashMap &.
+   * @param function the function.
+   * @return what the function returns.
+   */
+  template<class Function>
+  auto read (Function function) const
+  {
+    EpochDomain::ReadGuard guard;
+    return function (*current_.load ());
+  }
+
+  /**
+   * This method returns the size of the hash map.
+   * @return size of the hash map.
+   */
+  int size () const
+  {
+    EpochDomain::ReadGuard guard;
+    return current_.load ()->size ();
+  }
+
+  /**
+   * This method check if the hash map is empty.
+   * @return true if the hash map is empty, false otherwise.
+   */
+  bool empty () const
+  {
+    return size () == INITIAL_INT;
+  }
+
+  /**
+   * This method applies a batch of changes: the function changes a copy of
+   * the current snapshot, which is then published at once. Writers are
+   * serialized; readers are never blocked.
+   * @tparam Function a callable that takes a HashMap &.
+   * @param function the function.
+   */
+  template<class Function>
+  void modify (Function function)
+  {
+    std::lock_guard<std::mutex> lock (writer_mutex_);
+    auto *next = new Snapshot (*current_.load ());
+    try
+    {
+      function (*next);
+    }
+    catch (...)
+    {
+      delete next;
+      throw;
+    }
+    publish (next);
+  }
+
+  /**
+   * This method replaces all the items of the map, without copying the
+   * current snapshot.
+   * @param items the new items.
+   */
+  void assign (Snapshot items)
+  {
+    std::lock_guard<std::mutex> lock (writer_mutex_);
+    publish (new Snapshot (std::move (items)));
+  }
+
+  /**
+   * This method insert a key-value pair into the hash map.
+   * @param key
+   * @param value
+   * @return true if the key-value pair is inserted, false otherwise.
+   */
+  bool insert (const KeyT &key, const ValueT &value)
+  {
+    bool inserted = false;
+    modify ([&] (Snapshot &items)
+            { inserted = items.insert (key, value); });
+    return inserted;
+  }
+
+  /**
+   * This method sets the value of a key.
+   * @param key
+   * @param value
+   * @return true if the key-value pair is inserted, false if the value of an
+   * existing key was replaced.
+   */
+  bool insert_or_assign (const KeyT &key, const ValueT &value)
+  {
+    bool inserted = false;
+    modify ([&] (Snapshot &items)
+            { inserted = items.insert_or_assign (key, value); });
+    return inserted;
+  }
+
+  /**
+   * This method erase a key-value pair from the hash map.
+   * @param key
+   * @return if the key is in the hash map, erase the key-value pair and
+   * return true, otherwise, return false.
+   */
+  bool erase (const KeyT &key)
+  {
+    bool erased = false;
+    modify ([&] (Snapshot &items) { erased = items.erase (key); });
+    return erased;
+  }
+
+ private:
+  std::atomic<Snapshot *> current_;
+  std::mutex writer_mutex_;
+  // Snapshots that were replaced, with the epoch in which they were.
+  std::vector<std::pair<Snapshot *, uint64_t>> retired_;
+
+  /**
+   * This function makes a new snapshot the current one, retires the old
+   * one, and frees the retired snapshots that no reader can hold anymore.
+   * The writer mutex must be held.
+   * @param next the new snapshot.
+   */
+  void publish (Snapshot *next)
+  {
+    Snapshot *previous = current_.exchange (next);
+    EpochDomain &domain = EpochDomain::instance ();
+    retired_.emplace_back (previous, domain.advance ());
+    size_t kept = 0;
+    for (auto &retired: retired_)
+    {
+      if (domain.can_free (retired.second))
+      {
+        delete retired.first;
+      }
+      else
+      {
+        retired_[kept++] = retired;
+      }
+    }
+    retired_.resize (kept);
+  }
+};
+
+#endif //_READMOSTLYHASHMAP_HPP_
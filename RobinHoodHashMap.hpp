@@ -0,0 +1,587 @@
+#ifndef _ROBINHOODHASHMAP_HPP_
+#define _ROBINHOODHASHMAP_HPP_
+
+#include <vector>
+#include <stdexcept>
+#include <utility>
+#include <functional>
+#include <new>
+#include "HashMap.hpp"
+
+#define ROBIN_HOOD_MAX_LOAD_FACTOR 0.875
+#define EMPTY_SLOT 0
+
+/**
+ * An open-addressing hash map with Robin Hood probing. All the items are
+ * kept in one flat array of slots, so a lookup walks consecutive memory
+ * instead of chasing a pointer to a separately allocated bucket.
+ * Every slot remembers its distance from the home slot of its key (plus one,
+ * so that 0 marks an empty slot). On insert, a key that is further from its
+ * home slot takes the place of a key that is closer to its own home, which
+ * keeps the probe sequences short and lets a lookup stop early on a miss.
+ * Erasing uses backward-shift deletion, so no tombstones are left behind.
+ * The public API is the same as the API of HashMap.
+ */
+template<typename KeyT, typename ValueT>
+class RobinHoodHashMap
+{
+ protected:
+  class IteratorConst;
+
+ public:
+  typedef std::pair<KeyT, ValueT> Pair;
+  typedef IteratorConst Iterator;
+
+  /**
+   * Default constructor
+   */
+  RobinHoodHashMap ()
+  {
+    size_ = INITIAL_INT;
+    capacity_ = DEFAULT_CAPACITY;
+    allocate (capacity_);
+  }
+
+  /**
+   * Constructor that takes two vectors of the same size and creates a hash
+   * map. For a key that appears more than once, the last value is kept.
+   * @param keys vector of keys
+   * @param values vector of values
+   */
+  RobinHoodHashMap (const std::vector<KeyT> &keys,
+                    const std::vector<ValueT> &values)
+  {
+    if (keys.size () != values.size ())
+    {
+      throw std::invalid_argument (MESSAGE_UNMATCHED_SIZE);
+    }
+    size_ = INITIAL_INT;
+    capacity_ = DEFAULT_CAPACITY;
+    allocate (capacity_);
+    for (unsigned long i = 0; i < keys.size (); ++i)
+    {
+      this->operator[] (keys[i]) = values[i];
+    }
+  }
+
+  /**
+   * Copy constructor
+   * @param other the other hash map.
+   */
+  RobinHoodHashMap (const RobinHoodHashMap &other)
+  {
+    size_ = INITIAL_INT;
+    capacity_ = other.capacity_;
+    allocate (capacity_);
+    for (int i = 0; i < capacity_; ++i)
+    {
+      if (other.distances_[i] != EMPTY_SLOT)
+      {
+        new (&slots_[i]) Pair (other.slots_[i]);
+        distances_[i] = other.distances_[i];
+        size_++;
+      }
+    }
+  }
+
+  /**
+   * Destructor
+   */
+  virtual ~RobinHoodHashMap ()
+  {
+    release ();
+  }
+
+  /**
+   * This method returns the size of the hash map.
+   * @return size of the hash map.
+   */
+  int size () const
+  {
+    return size_;
+  }
+
+  /**
+   * This method returns the capacity (the number of slots) of the hash map.
+   * @return capacity of the hash map.
+   */
+  int capacity () const
+  {
+    return capacity_;
+  }
+
+  /**
+   * This method check if the hash map is empty.
+   * @return true if the hash map is empty, false otherwise.
+   */
+  bool empty () const
+  {
+    return size_ == INITIAL_INT;
+  }
+
+  /**
+   * This method returns the load factor of the hash map.
+   * @return load factor of the hash map.
+   */
+  double get_load_factor () const
+  {
+    return (double) size_ / capacity_;
+  }
+
+  /**
+   * This method insert a key-value pair into the hash map.
+   * @param key
+   * @param value
+   * @return true if the key-value pair is inserted, false if the key is
+   * already in the hash map.
+   */
+  bool insert (const KeyT &key, const ValueT &value)
+  {
+    if (find_slot (key) != NOT_FOUND)
+    {
+      return false;
+    }
+    if (size_ + 1 > capacity_ * ROBIN_HOOD_MAX_LOAD_FACTOR)
+    {
+      rehash (capacity_ * RESIZE_FACTOR);
+    }
+    place (Pair (key, value));
+    return true;
+  }
+
+  /**
+   * This method check if a key is in the hash map.
+   * @param key
+   * @return true if the key is in the hash map, false otherwise.
+   */
+  bool contains_key (const KeyT &key) const
+  {
+    return find_slot (key) != NOT_FOUND;
+  }
+
+  /**
+   * This method returns the value of a key.
+   * @param key
+   * @return if the key is in the hash map, return the value of the key,
+   * otherwise, throw an exception.
+   */
+  ValueT &at (const KeyT &key)
+  {
+    int slot = find_slot (key);
+    if (slot == NOT_FOUND)
+    {
+      throw std::out_of_range (MESSAGE_KEY_NOT_FOUND);
+    }
+    return slots_[slot].second;
+  }
+
+  /**
+   * This method returns the value of a key. This method is const.
+   * @param key
+   * @return if the key is in the hash map, return the value of the key,
+   * otherwise, throw an exception.
+   */
+  const ValueT &at (const KeyT &key) const
+  {
+    int slot = find_slot (key);
+    if (slot == NOT_FOUND)
+    {
+      throw std::out_of_range (MESSAGE_KEY_NOT_FOUND);
+    }
+    return slots_[slot].second;
+  }
+
+  /**
+   * This method erase a key-value pair from the hash map. The items that
+   * follow the erased slot are shifted one slot back, until an empty slot
+   * or an item that sits in its home slot is reached.
+   * @param key
+   * @return if the key is in the hash map, erase the key-value pair and
+   * return true, otherwise, return false.
+   */
+  virtual bool erase (const KeyT &key)
+  {
+    int slot = find_slot (key);
+    if (slot == NOT_FOUND)
+    {
+      return false;
+    }
+    int mask = capacity_ - 1;
+    int next = (slot + 1) & mask;
+    while (distances_[next] > 1)
+    {
+      slots_[slot] = std::move (slots_[next]);
+      distances_[slot] = distances_[next] - 1;
+      slot = next;
+      next = (next + 1) & mask;
+    }
+    slots_[slot].~Pair ();
+    distances_[slot] = EMPTY_SLOT;
+    size_--;
+    if (capacity_ > DEFAULT_CAPACITY
+        && get_load_factor () < MIN_LOAD_FACTOR)
+    {
+      rehash (capacity_ / RESIZE_FACTOR);
+    }
+    return true;
+  }
+
+  /**
+   * This method removes all the items from the hash map. The capacity is
+   * not changed.
+   */
+  void clear ()
+  {
+    for (int i = 0; i < capacity_; ++i)
+    {
+      if (distances_[i] != EMPTY_SLOT)
+      {
+        slots_[i].~Pair ();
+        distances_[i] = EMPTY_SLOT;
+      }
+    }
+    size_ = INITIAL_INT;
+  }
+
+  /**
+   * This function swap the two hash maps.
+   * @param other the other hash map.
+   */
+  void swap (RobinHoodHashMap &other)
+  {
+    std::swap (capacity_, other.capacity_);
+    std::swap (size_, other.size_);
+    std::swap (slots_, other.slots_);
+    std::swap (distances_, other.distances_);
+  }
+
+  /**
+   * This is assignment operator. It assigns the other hash map to this.
+   * @param other the other hash map.
+   * @return the reference to this hash map.
+   */
+  RobinHoodHashMap &operator= (RobinHoodHashMap other)
+  {
+    swap (other);
+    return *this;
+  }
+
+  /**
+   * This is operator[]. It returns the value of the key, and inserts a
+   * default value if the key is not in the hash map.
+   * @param key the key.
+   * @return the value of the key.
+   */
+  ValueT &operator[] (const KeyT &key)
+  {
+    int slot = find_slot (key);
+    if (slot != NOT_FOUND)
+    {
+      return slots_[slot].second;
+    }
+    if (size_ + 1 > capacity_ * ROBIN_HOOD_MAX_LOAD_FACTOR)
+    {
+      rehash (capacity_ * RESIZE_FACTOR);
+    }
+    return slots_[place (Pair (key, ValueT ()))].second;
+  }
+
+  /**
+   * This is operator==. It returns true if the two hash maps are equal,
+   * Otherwise, return false.
+   * @param other the other hash map.
+   * @return true if the two hash maps are equal, Otherwise, return false.
+   */
+  bool operator== (const RobinHoodHashMap &other) const
+  {
+    if (size_ != other.size_)
+    {
+      return false;
+    }
+    for (auto it = cbegin (); it != cend (); ++it)
+    {
+      int slot = other.find_slot (it->first);
+      if (slot == NOT_FOUND || other.slots_[slot].second != it->second)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * This is operator!=. It returns true if the two hash maps are not equal.
+   * @param other the other hash map.
+   * @return true if the two hash maps are not equal. Otherwise, return false.
+   */
+  bool operator!= (const RobinHoodHashMap &other) const
+  {
+    return !(*this == other);
+  }
+
+ protected:
+  static const int NOT_FOUND = -1;
+
+  int capacity_;
+  int size_;
+  Pair *slots_;
+  unsigned int *distances_;
+
+  /**
+   * This is nested class for iterator. It walks the slots in order and
+   * skips the empty ones.
+   */
+  class IteratorConst
+  {
+    friend class RobinHoodHashMap;
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef const Pair value_type;
+    typedef const Pair &reference;
+    typedef const Pair *pointer;
+    typedef std::ptrdiff_t difference_type;
+
+    /**
+     * This is the default constructor.
+     */
+    explicit IteratorConst (const RobinHoodHashMap &hash_map,
+                            bool end = false) : hash_map_ (hash_map)
+    {
+      slot_index_ = end ? hash_map_.capacity_ : INITIAL_INT;
+      skip_empty ();
+    }
+
+    /**
+     * This is operator*. It returns the value of the iterator.
+     * @return
+     */
+    reference operator* () const
+    {
+      return hash_map_.slots_[slot_index_];
+    }
+
+    /**
+     * This is operator->. It returns the pointer of the iterator.
+     * @return
+     */
+    pointer operator-> () const
+    {
+      return &hash_map_.slots_[slot_index_];
+    }
+
+    /**
+     * This is operator++. It returns the next iterator.
+     * @return the next iterator.
+     */
+    IteratorConst &operator++ ()
+    {
+      slot_index_ += 1;
+      skip_empty ();
+      return *this;
+    }
+
+    /**
+     * This is operator++. It returns the current iterator and then
+     * increment the iterator.
+     * @return the current iterator.
+     */
+    IteratorConst operator++ (int)
+    {
+      IteratorConst tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+
+    /**
+     * This is operator==. It returns true if the two iterators are equal.
+     * @param other
+     * @return true if the two iterators are equal. Otherwise, return false.
+     */
+    bool operator== (const IteratorConst &other) const
+    {
+      return slot_index_ == other.slot_index_
+             && &hash_map_ == &other.hash_map_;
+    }
+
+    /**
+     * This is operator!=. It returns true if the two iterators are not
+     * equal.
+     * @param other
+     * @return true if the two iterators are not equal. Otherwise, return
+     * false.
+     */
+    bool operator!= (const IteratorConst &other) const
+    {
+      return !(*this == other);
+    }
+
+   protected:
+    const RobinHoodHashMap &hash_map_;
+    int slot_index_;
+
+    /**
+     * Moves the iterator forward to the next occupied slot.
+     */
+    void skip_empty ()
+    {
+      while (slot_index_ < hash_map_.capacity_
+             && hash_map_.distances_[slot_index_] == EMPTY_SLOT)
+      {
+        slot_index_ += 1;
+      }
+    }
+  };
+
+ public:
+
+  /**
+   * This is cbegin method.
+   * @return It returns the iterator to the beginning.
+   */
+  Iterator cbegin () const
+  {
+    return IteratorConst (*this);
+  }
+
+  /**
+   * This is cend method.
+   * @return It returns the iterator to the end.
+   */
+  Iterator cend () const
+  {
+    return IteratorConst (*this, true);
+  }
+
+  /**
+   * This is begin method.
+   * @return It returns the iterator to the beginning.
+   */
+  Iterator begin () const
+  {
+    return IteratorConst (*this);
+  }
+
+  /**
+   * This is end method.
+   * @return It returns the iterator to the end.
+   */
+  Iterator end () const
+  {
+    return IteratorConst (*this, true);
+  }
+
+ private:
+
+  /**
+   * This function moves all the items into a new array of slots.
+   * @param new_capacity the number of slots in the new array, a power of
+   * two that is large enough to hold all the items.
+   */
+  void rehash (int new_capacity)
+  {
+    Pair *old_slots = slots_;
+    unsigned int *old_distances = distances_;
+    int old_capacity = capacity_;
+    allocate (new_capacity);
+    capacity_ = new_capacity;
+    size_ = INITIAL_INT;
+    for (int i = 0; i < old_capacity; ++i)
+    {
+      if (old_distances[i] != EMPTY_SLOT)
+      {
+        place (std::move (old_slots[i]));
+        old_slots[i].~Pair ();
+      }
+    }
+    ::operator delete (old_slots);
+    delete[] old_distances;
+  }
+
+  /**
+   * This function allocates an empty array of slots. The items are
+   * constructed in place only when they are inserted.
+   * @param capacity the number of slots.
+   */
+  void allocate (int capacity)
+  {
+    slots_ = static_cast<Pair *> (::operator new (sizeof (Pair) * capacity));
+    distances_ = new unsigned int[capacity] ();
+  }
+
+  /**
+   * This function destroys all the items and frees the array of slots.
+   */
+  void release ()
+  {
+    for (int i = 0; i < capacity_; ++i)
+    {
+      if (distances_[i] != EMPTY_SLOT)
+      {
+        slots_[i].~Pair ();
+      }
+    }
+    ::operator delete (slots_);
+    delete[] distances_;
+  }
+
+  /**
+   * This function looks for the slot of a key. The search stops as soon as
+   * it meets a slot whose item is closer to its home than the key would be,
+   * since the key would have taken that slot when it was inserted.
+   * @param key
+   * @return the index of the slot of the key, or NOT_FOUND.
+   */
+  int find_slot (const KeyT &key) const
+  {
+    int mask = capacity_ - 1;
+    int slot = (int) (std::hash<KeyT>{} (key) & mask);
+    unsigned int distance = 1;
+    while (distances_[slot] >= distance)
+    {
+      if (distances_[slot] == distance && slots_[slot].first == key)
+      {
+        return slot;
+      }
+      slot = (slot + 1) & mask;
+      distance++;
+    }
+    return NOT_FOUND;
+  }
+
+  /**
+   * This function places an item that is not in the hash map yet. The item
+   * steals the slot of any item that is closer to its own home, and the
+   * displaced item continues the probe in its place.
+   * There must be at least one empty slot.
+   * @param item the item to place.
+   * @return the index of the slot in which the given item was placed.
+   */
+  int place (Pair &&item)
+  {
+    int mask = capacity_ - 1;
+    int slot = (int) (std::hash<KeyT>{} (item.first) & mask);
+    unsigned int distance = 1;
+    int placed = NOT_FOUND;
+    Pair carried (std::move (item));
+    while (distances_[slot] != EMPTY_SLOT)
+    {
+      if (distances_[slot] < distance)
+      {
+        std::swap (carried, slots_[slot]);
+        std::swap (distance, distances_[slot]);
+        if (placed == NOT_FOUND)
+        {
+          placed = slot;
+        }
+      }
+      slot = (slot + 1) & mask;
+      distance++;
+    }
+    new (&slots_[slot]) Pair (std::move (carried));
+    distances_[slot] = distance;
+    size_++;
+    return placed == NOT_FOUND ? slot : placed;
+  }
+};
+
+#endif //_ROBINHOODHASHMAP_HPP_
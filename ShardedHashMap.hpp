@@ -0,0 +1,448 @@
+#ifndef _SHARDEDHASHMAP_HPP_
+#define _SHARDEDHASHMAP_HPP_
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <cstdint>
+#include <utility>
+#include "HashMap.hpp"
+#include "Dictionary.hpp"
+#include "CacheLine.hpp"
+
+#define DEFAULT_SHARDS 16
+#define SHARD_HASH_MULTIPLIER 0x9E3779B97F4A7C15ULL
+#define MESSAGE_INVALID_SHARDS "Number of shards is not a power of two"
+
+/**
+ * A hash map that splits its keys between independent HashMap shards, so
+ * that threads that work on different shards do not wait for each other.
+ * The shard of a key is chosen by the high bits of its hash, after it is
+ * mixed; the shard itself places the key by the low bits, so the two
+ * choices do not depend on each other. Every shard has its own reader/writer
+ * lock and its own resizes, and is kept on its own cache lines, so a resize
+ * of one shard never stalls the others.
+ * Values are copied out of the map, since a reference into a shard would
+ * not be safe once its lock is released.
+ */
+template<typename KeyT, typename ValueT>
+class ShardedHashMap
+{
+ public:
+  typedef HashMap<KeyT, ValueT> Shard;
+
+  /**
+   * A constructor of an empty map.
+   * @param shards the number of shards, a power of two.
+   */
+  explicit ShardedHashMap (int shards = DEFAULT_SHARDS)
+  {
+    init_shards (shards);
+  }
+
+  /**
+   * A constructor that gets a vector of keys and a vector of values. Every
+   * shard is sized once for the keys that fall into it. If a key appears
+   * more than once, its last value is kept.
+   * @param keys this is a vector of keys.
+   * @param values this is a vector of values.
+   * @param shards the number of shards, a power of two.
+   */
+  ShardedHashMap (std::vector<KeyT> keys, std::vector<ValueT> values,
+                  int shards = DEFAULT_SHARDS)
+  {
+    if (keys.size () != values.size ())
+    {
+      throw std::invalid_argument (MESSAGE_UNMATCHED_SIZE);
+    }
+    init_shards (shards);
+    std::vector<std::vector<size_t>> groups = group_by_shard (
+        keys.size (), [&keys] (size_t i) -> const KeyT &
+        { return keys[i]; });
+    for (int s = 0; s < shards_count_; s++)
+    {
+      Shard &shard = shards_[s].map;
+      shard.reserve ((int) groups[s].size ());
+      for (size_t i: groups[s])
+      {
+        shard.insert_or_assign (std::move (keys[i]), std::move (values[i]));
+      }
+    }
+  }
+
+  ShardedHashMap (const ShardedHashMap &other) = delete;
+
+  ShardedHashMap &operator= (const ShardedHashMap &other) = delete;
+
+  virtual ~ShardedHashMap () = default;
+
+  /**
+   * This method returns the number of shards.
+   * @return number of shards.
+   */
+  int shards () const
+  {
+    return shards_count_;
+  }
+
+  /**
+   * This method returns the size of the hash map. Other threads may change
+   * it while the shards are counted.
+   * @return size of the hash map.
+   */
+  int size () const
+  {
+    int size = INITIAL_INT;
+    for (int s = 0; s < shards_count_; s++)
+    {
+      std::shared_lock<std::shared_mutex> lock (shards_[s].mutex);
+      size += shards_[s].map.size ();
+    }
+    return size;
+  }
+
+  /**
+   * This method check if the hash map is empty.
+   * @return true if the hash map is empty, false otherwise.
+   */
+  bool empty () const
+  {
+    return size () == INITIAL_INT;
+  }
+
+  /**
+   * This method returns the capacity of the hash map, the sum of the
+   * capacities of its shards.
+   * @return capacity of the hash map.
+   */
+  int capacity () const
+  {
+    int capacity = INITIAL_INT;
+    for (int s = 0; s < shards_count_; s++)
+    {
+      std::shared_lock<std::shared_mutex> lock (shards_[s].mutex);
+      capacity += shards_[s].map.capacity ();
+    }
+    return capacity;
+  }
+
+  /**
+   * This method insert a key-value pair into the hash map.
+   * @param key
+   * @param value
+   * @return true if the key-value pair is inserted, false if the key is
+   * already in the hash map.
+   */
+  bool insert (const KeyT &key, const ValueT &value)
+  {
+    ShardSlot &shard = shard_of (key);
+    std::unique_lock<std::shared_mutex> lock (shard.mutex);
+    return shard.map.insert (key, value);
+  }
+
+  /**
+   * This method sets the value of a key: the value of an existing key is
+   * replaced, and a missing key is inserted.
+   * @param key
+   * @param value
+   * @return true if the key-value pair is inserted, false if the value of an
+   * existing key was replaced.
+   */
+  bool insert_or_assign (const KeyT &key, const ValueT &value)
+  {
+    ShardSlot &shard = shard_of (key);
+    std::unique_lock<std::shared_mutex> lock (shard.mutex);
+    return shard.map.insert_or_assign (key, value);
+  }
+
+  /**
+   * This method looks for a key and copies its value out.
+   * @param key
+   * @param value set to the value of the key, if the key is found.
+   * @return true if the key is in the hash map, false otherwise.
+   */
+  bool find (const KeyT &key, ValueT &value) const
+  {
+    const ShardSlot &shard = shard_of (key);
+    std::shared_lock<std::shared_mutex> lock (shard.mutex);
+    auto it = shard.map.find (key);
+    if (it == shard.map.end ())
+    {
+      return false;
+    }
+    value = it->second;
+    return true;
+  }
+
+  /**
+   * This method returns a copy of the value of a key.
+   * @param key
+   * @return if the key is in the hash map, return the value of the key,
+   * otherwise, throw an exception.
+   */
+  ValueT at (const KeyT &key) const
+  {
+    const ShardSlot &shard = shard_of (key);
+    std::shared_lock<std::shared_mutex> lock (shard.mutex);
+    return shard.map.at (key);
+  }
+
+  /**
+   * This method check if a key is in the hash map.
+   * @param key
+   * @return true if the key is in the hash map, false otherwise.
+   */
+  bool contains_key (const KeyT &key) const
+  {
+    const ShardSlot &shard = shard_of (key);
+    std::shared_lock<std::shared_mutex> lock (shard.mutex);
+    return shard.map.contains_key (key);
+  }
+
+  /**
+   * This method applies a function to the value of a key, while holding the
+   * lock of its shard, so that reading and changing the value is atomic.
+   * The function must not call back into the hash map.
+   * @tparam Function a callable that takes a ValueT &.
+   * @param key
+   * @param function the function to apply.
+   * @return true if the key is in the hash map, false otherwise.
+   */
+  template<class Function>
+  bool update (const KeyT &key, Function function)
+  {
+    ShardSlot &shard = shard_of (key);
+    std::unique_lock<std::shared_mutex> lock (shard.mutex);
+    auto it = shard.map.find (key);
+    if (it == shard.map.end ())
+    {
+      return false;
+    }
+    // The iterators of HashMap are const, but the shard is not.
+    function (const_cast<ValueT &> (it->second));
+    return true;
+  }
+
+  /**
+   * This method get two iterators and it updates the hash map with the
+   * items that are in this range. The items are first grouped by shard, so
+   * that every shard is locked once. If a key appears more than once, its
+   * last value is kept.
+   * @tparam ForwardIterator The type of the iterators.
+   * @param first The first iterator.
+   * @param last The last iterator.
+   */
+  template<class ForwardIterator>
+  void update (ForwardIterator first, ForwardIterator last)
+  {
+    std::vector<std::vector<ForwardIterator>> groups (shards_count_);
+    for (; first != last; ++first)
+    {
+      groups[shard_index (first->first)].push_back (first);
+    }
+    for (int s = 0; s < shards_count_; s++)
+    {
+      if (groups[s].empty ())
+      {
+        continue;
+      }
+      std::unique_lock<std::shared_mutex> lock (shards_[s].mutex);
+      for (auto &item: groups[s])
+      {
+        shards_[s].map.insert_or_assign (item->first, item->second);
+      }
+    }
+  }
+
+  /**
+   * This method erase a key-value pair from the hash map.
+   * @param key
+   * @return if the key is in the hash map, erase the key-value pair and
+   * return true, otherwise, return false.
+   */
+  virtual bool erase (const KeyT &key)
+  {
+    ShardSlot &shard = shard_of (key);
+    std::unique_lock<std::shared_mutex> lock (shard.mutex);
+    return shard.map.erase (key);
+  }
+
+  /**
+   * This method calls a function with every key-value pair, one shard at a
+   * time, while holding the lock of the shard. The function must not call
+   * back into the hash map.
+   * @tparam Function a callable that takes a const std::pair<KeyT, ValueT> &.
+   * @param function the function.
+   */
+  template<class Function>
+  void for_each (Function function) const
+  {
+    for (int s = 0; s < shards_count_; s++)
+    {
+      std::shared_lock<std::shared_mutex> lock (shards_[s].mutex);
+      for (const auto &item: shards_[s].map)
+      {
+        function (item);
+      }
+    }
+  }
+
+  /**
+   * This method removes all the items from the hash map.
+   */
+  void clear ()
+  {
+    for (int s = 0; s < shards_count_; s++)
+    {
+      std::unique_lock<std::shared_mutex> lock (shards_[s].mutex);
+      shards_[s].map.clear ();
+    }
+  }
+
+ protected:
+
+  /**
+   * A shard and its lock, on cache lines of their own, so that threads that
+   * use different shards do not slow each other down.
+   */
+  struct alignas(CACHE_LINE_SIZE) ShardSlot
+  {
+    mutable std::shared_mutex mutex;
+    Shard map;
+  };
+
+  std::unique_ptr<ShardSlot[]> shards_;
+  int shards_count_;
+  int shard_shift_;
+
+  /**
+   * This function allocates the shards.
+   * @param shards the number of shards, a power of two.
+   */
+  void init_shards (int shards)
+  {
+    if (shards <= 0 || (shards & (shards - 1)) != 0)
+    {
+      throw std::invalid_argument (MESSAGE_INVALID_SHARDS);
+    }
+    shards_count_ = shards;
+    shard_shift_ = 64;
+    while (shards > 1)
+    {
+      shards >>= 1;
+      shard_shift_--;
+    }
+    shards_.reset (new ShardSlot[shards_count_]);
+  }
+
+  /**
+   * This function finds the shard of a key by the high bits of its mixed
+   * hash. std::hash of an integer is the integer itself, so it is mixed
+   * first to spread small keys between the shards.
+   * @param key the key.
+   * @return the index of the shard of the key.
+   */
+  int shard_index (const KeyT &key) const
+  {
+    if (shards_count_ == 1)
+    {
+      return 0;
+    }
+    uint64_t mixed = (uint64_t) std::hash<KeyT>{} (key) * SHARD_HASH_MULTIPLIER;
+    return (int) (mixed >> shard_shift_);
+  }
+
+  /**
+   * @param key the key.
+   * @return the shard of the key.
+   */
+  ShardSlot &shard_of (const KeyT &key)
+  {
+    return shards_[shard_index (key)];
+  }
+
+  /**
+   * @param key the key.
+   * @return the shard of the key.
+   */
+  const ShardSlot &shard_of (const KeyT &key) const
+  {
+    return shards_[shard_index (key)];
+  }
+
+  /**
+   * This function groups items by the shard of their key, keeping their
+   * order.
+   * @tparam KeyOf a callable that returns the key of an item by its index.
+   * @param items the number of items.
+   * @param key_of the callable.
+   * @return the indices of the items of every shard.
+   */
+  template<class KeyOf>
+  std::vector<std::vector<size_t>> group_by_shard (size_t items,
+                                                   KeyOf key_of) const
+  {
+    std::vector<std::vector<size_t>> groups (shards_count_);
+    for (size_t i = 0; i < items; i++)
+    {
+      groups[shard_index (key_of (i))].push_back (i);
+    }
+    return groups;
+  }
+};
+
+/**
+ * A Dictionary whose keys are split between independent shards, for
+ * dictionaries that are shared by many threads. Like Dictionary, erasing a
+ * missing key throws InvalidKey.
+ */
+class ShardedDictionary : public ShardedHashMap<std::string, std::string>
+{
+ public:
+
+  /**
+   * A constructor of an empty dictionary.
+   * @param shards the number of shards, a power of two.
+   */
+  explicit ShardedDictionary (int shards = DEFAULT_SHARDS)
+      : ShardedHashMap (shards)
+  {
+  }
+
+  /**
+   * A constructor of ShardedDictionary.
+   * @param Key_Vector this is a vector of keys.
+   * @param Value_Vector this is a vector of values.
+   * @param shards the number of shards, a power of two.
+   */
+  ShardedDictionary (std::vector<std::string> Key_Vector,
+                     std::vector<std::string> Value_Vector,
+                     int shards = DEFAULT_SHARDS)
+      : ShardedHashMap (std::move (Key_Vector), std::move (Value_Vector),
+                        shards)
+  {
+  }
+
+  /**
+   * This method get a key and if the key is in the dictionary,
+   * it erase the value associated with the key.
+   * If the key is not in the dictionary, it throws an exception.
+   * @param Key The key.
+   * @return True if the erase was successful, otherwise it throws an
+   * exception.
+   */
+  bool erase (const std::string &Key) override
+  {
+    if (!ShardedHashMap<std::string, std::string>::erase (Key))
+    {
+      throw InvalidKey (MESSAGE_KEY_NOT_FOUND);
+    }
+    return true;
+  }
+};
+
+#endif //_SHARDEDHASHMAP_HPP_
@@ -0,0 +1,263 @@
+#ifndef _SNAPSHOT_HPP_
+#define _SNAPSHOT_HPP_
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#define SNAPSHOT_MAGIC "HMSNAP"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BUFFER_SIZE (1 << 20)
+#define SNAPSHOT_STRING_SIZE 0
+#define MESSAGE_SNAPSHOT_OPEN "Cannot open snapshot file"
+#define MESSAGE_SNAPSHOT_WRITE "Cannot write snapshot file"
+#define MESSAGE_SNAPSHOT_INVALID "Invalid snapshot file"
+
+/**
+ * Writes a file through a large buffer: small writes are copied into the
+ * buffer, and the buffer goes to the file in one fwrite when it is full.
+ */
+class SnapshotWriter
+{
+ public:
+  /**
+   * A constructor that creates the file.
+   * @param path the path of the file. An existing file is replaced.
+   */
+  explicit SnapshotWriter (const std::string &path)
+      : file_ (std::fopen (path.c_str (), "wb"))
+  {
+    if (file_ == nullptr)
+    {
+      throw std::runtime_error (MESSAGE_SNAPSHOT_OPEN);
+    }
+    buffer_.reserve (SNAPSHOT_BUFFER_SIZE);
+  }
+
+  SnapshotWriter (const SnapshotWriter &other) = delete;
+
+  SnapshotWriter &operator= (const SnapshotWriter &other) = delete;
+
+  /**
+   * Destructor. A writer that was not closed drops what is left.
+   */
+  ~SnapshotWriter ()
+  {
+    if (file_ != nullptr)
+    {
+      std::fclose (file_);
+    }
+  }
+
+  /**
+   * This function writes bytes.
+   * @param data the bytes.
+   * @param size the number of bytes.
+   */
+  void put (const void *data, size_t size)
+  {
+    if (buffer_.size () + size > SNAPSHOT_BUFFER_SIZE)
+    {
+      flush ();
+    }
+    if (size >= SNAPSHOT_BUFFER_SIZE)
+    {
+      write (data, size);
+      return;
+    }
+    const char *bytes = (const char *) data;
+    buffer_.insert (buffer_.end (), bytes, bytes + size);
+  }
+
+  /**
+   * This function writes what is left in the buffer and closes the file.
+   */
+  void close ()
+  {
+    flush ();
+    FILE *file = file_;
+    file_ = nullptr;
+    if (std::fclose (file) != 0)
+    {
+      throw std::runtime_error (MESSAGE_SNAPSHOT_WRITE);
+    }
+  }
+
+ private:
+  FILE *file_;
+  std::vector<char> buffer_;
+
+  /**
+   * This function writes the buffer to the file.
+   */
+  void flush ()
+  {
+    write (buffer_.data (), buffer_.size ());
+    buffer_.clear ();
+  }
+
+  /**
+   * This function writes bytes straight to the file.
+   * @param data the bytes.
+   * @param size the number of bytes.
+   */
+  void write (const void *data, size_t size)
+  {
+    if (size > 0 && std::fwrite (data, 1, size, file_) != size)
+    {
+      throw std::runtime_error (MESSAGE_SNAPSHOT_WRITE);
+    }
+  }
+};
+
+/**
+ * Reads a file through a large buffer, the counterpart of SnapshotWriter.
+ */
+class SnapshotReader
+{
+ public:
+  /**
+   * A constructor that opens the file.
+   * @param path the path of the file.
+   */
+  explicit SnapshotReader (const std::string &path)
+      : file_ (std::fopen (path.c_str (), "rb"))
+  {
+    if (file_ == nullptr)
+    {
+      throw std::runtime_error (MESSAGE_SNAPSHOT_OPEN);
+    }
+    buffer_.resize (SNAPSHOT_BUFFER_SIZE);
+  }
+
+  SnapshotReader (const SnapshotReader &other) = delete;
+
+  SnapshotReader &operator= (const SnapshotReader &other) = delete;
+
+  /**
+   * Destructor
+   */
+  ~SnapshotReader ()
+  {
+    std::fclose (file_);
+  }
+
+  /**
+   * This function reads bytes. A file that ends too early is invalid.
+   * @param data where to put the bytes.
+   * @param size the number of bytes.
+   */
+  void get (void *data, size_t size)
+  {
+    char *bytes = (char *) data;
+    while (size > 0)
+    {
+      if (position_ == end_)
+      {
+        fill ();
+      }
+      size_t chunk = std::min (size, end_ - position_);
+      std::memcpy (bytes, buffer_.data () + position_, chunk);
+      position_ += chunk;
+      bytes += chunk;
+      size -= chunk;
+    }
+  }
+
+ private:
+  FILE *file_;
+  std::vector<char> buffer_;
+  size_t position_ = 0;
+  size_t end_ = 0;
+
+  /**
+   * This function reads the next chunk of the file into the buffer.
+   */
+  void fill ()
+  {
+    end_ = std::fread (buffer_.data (), 1, buffer_.size (), file_);
+    position_ = 0;
+    if (end_ == 0)
+    {
+      throw std::runtime_error (MESSAGE_SNAPSHOT_INVALID);
+    }
+  }
+};
+
+/**
+ * The header at the start of a snapshot file.
+ */
+struct SnapshotHeader
+{
+  char magic[8];
+  uint32_t version;
+  // snapshot_io<T>::size of the key and value types.
+  uint32_t key_size;
+  uint32_t value_size;
+  uint32_t reserved;
+  uint64_t capacity;
+  uint64_t size;
+};
+
+/**
+ * Tells how a type is written to a snapshot. Trivially copyable types are
+ * written as their bytes, and std::string as its length and then its
+ * characters. Other types are not supported.
+ */
+template<typename T, typename = void>
+struct snapshot_io
+{
+};
+
+/**
+ * Trivially copyable types: their bytes, as they are in memory.
+ */
+template<typename T>
+struct snapshot_io<T, typename std::enable_if<
+    std::is_trivially_copyable<T>::value>::type>
+{
+  // The size of the type, stored in the snapshot header to catch a
+  // snapshot that is loaded into a map of other types.
+  static constexpr uint32_t size = sizeof (T);
+
+  static void write (SnapshotWriter &writer, const T &item)
+  {
+    writer.put (&item, sizeof (T));
+  }
+
+  static void read (SnapshotReader &reader, T &item)
+  {
+    reader.get (&item, sizeof (T));
+  }
+};
+
+/**
+ * std::string: a 64-bit length followed by the characters.
+ */
+template<>
+struct snapshot_io<std::string>
+{
+  static constexpr uint32_t size = SNAPSHOT_STRING_SIZE;
+
+  static void write (SnapshotWriter &writer, const std::string &item)
+  {
+    uint64_t length = item.size ();
+    writer.put (&length, sizeof (length));
+    writer.put (item.data (), item.size ());
+  }
+
+  static void read (SnapshotReader &reader, std::string &item)
+  {
+    uint64_t length;
+    reader.get (&length, sizeof (length));
+    item.resize (length);
+    reader.get (&item[0], length);
+  }
+};
+
+#endif //_SNAPSHOT_HPP_
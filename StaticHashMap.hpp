@@ -0,0 +1,313 @@
+#ifndef _STATICHASHMAP_HPP_
+#define _STATICHASHMAP_HPP_
+
+#include <array>
+#include <algorithm>
+#include <string_view>
+#include <type_traits>
+#include <stdexcept>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include "HashMap.hpp"
+#include "Hashers.hpp"
+
+#define STATIC_HASH_MAP_MIN_CAPACITY 2
+#define STATIC_HASH_MAP_SLOTS_PER_KEY 2
+#define STATIC_HASH_MAP_SLOTS_DIVISOR 16
+#define STATIC_HASH_MAP_MAX_SEEDS (1 << 16)
+#define SPLITMIX_INCREMENT 0x9E3779B97F4A7C15ULL
+#define MESSAGE_STATIC_DUPLICATE_KEY "Duplicate key in a static hash map"
+#define MESSAGE_STATIC_NO_SEED "No seed places the keys, use a larger capacity"
+
+/**
+ * Tells how a key of a StaticHashMap is hashed at compile time. Integers
+ * and enums are their own hash, and std::string_view is hashed with 64-bit
+ * FNV-1a.
+ */
+template<typename T, typename = void>
+struct static_hash
+{
+};
+
+/**
+ * Integers and enums.
+ */
+template<typename T>
+struct static_hash<T, typename std::enable_if<
+    std::is_integral<T>::value || std::is_enum<T>::value>::type>
+{
+  static constexpr uint64_t hash (T key)
+  {
+    return (uint64_t) key;
+  }
+};
+
+/**
+ * std::string_view, and so std::string and const char* too, which convert
+ * to it.
+ */
+template<>
+struct static_hash<std::string_view>
+{
+  static constexpr uint64_t hash (std::string_view key)
+  {
+    return fnv1a (key);
+  }
+};
+
+/**
+ * This function returns the default capacity of a StaticHashMap: a power
+ * of two with room enough that a random seed places all the keys in slots
+ * of their own after a few tries.
+ * @param items the number of items.
+ * @return the capacity.
+ */
+constexpr size_t static_hash_map_capacity (size_t items)
+{
+  size_t slots = std::max (items * STATIC_HASH_MAP_SLOTS_PER_KEY,
+                           items * items / STATIC_HASH_MAP_SLOTS_DIVISOR);
+  size_t capacity = STATIC_HASH_MAP_MIN_CAPACITY;
+  while (capacity < slots)
+  {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+/**
+ * A map of a fixed set of keys that is laid out at compile time, and needs
+ * no heap memory: the items live in an array of Capacity slots inside the
+ * object. The constructor looks for a seed, an odd multiplier, for which
+ * the multiply-shift hash (hash * seed) >> shift sends every key to a slot
+ * of its own, so a lookup is a hash, a multiply, a shift and one compare
+ * of the key in its slot. The empty slots hold a copy of a key whose own
+ * slot is elsewhere, so that compare also fails for every key that is not
+ * in the map.
+ * Built as a constexpr variable, the map is constant data of the program.
+ * Keys are integers, enums or std::string_view (see static_hash); the keys
+ * and values must be literal types with a default constructor.
+ * @tparam N the number of items.
+ * @tparam Capacity the number of slots, a power of two. For large key sets
+ * where the default fails to find a seed, a larger one can be given.
+ */
+template<typename KeyT, typename ValueT, size_t N,
+    size_t Capacity = static_hash_map_capacity (N)>
+class StaticHashMap
+{
+  static_assert (Capacity >= STATIC_HASH_MAP_MIN_CAPACITY
+                 && (Capacity & (Capacity - 1)) == 0 && Capacity >= N,
+                 "Capacity must be a power of two of at least the items");
+
+ public:
+  typedef std::pair<KeyT, ValueT> Pair;
+
+  /**
+   * A constructor that lays the items out.
+   * @param items the items. Every key must appear once.
+   */
+  constexpr explicit StaticHashMap (const Pair (&items)[N])
+  {
+    if constexpr (N > 0)
+    {
+      std::array<uint64_t, N> hashes {};
+      for (size_t i = 0; i < N; i++)
+      {
+        hashes[i] = static_hash<KeyT>::hash (items[i].first);
+      }
+      seed_ = find_seed (items, hashes);
+      for (size_t slot = 0; slot < Capacity; slot++)
+      {
+        slots_[slot].first = items[0].first;
+      }
+      for (size_t i = 0; i < N; i++)
+      {
+        Slot &slot = slots_[index_of (hashes[i])];
+        slot.first = items[i].first;
+        slot.second = items[i].second;
+      }
+    }
+  }
+
+  /**
+   * This method returns the number of items.
+   * @return size of the map.
+   */
+  constexpr int size () const
+  {
+    return (int) N;
+  }
+
+  /**
+   * This method returns the number of slots.
+   * @return capacity of the map.
+   */
+  constexpr int capacity () const
+  {
+    return (int) Capacity;
+  }
+
+  /**
+   * This method check if the map is empty.
+   * @return true if the map is empty, false otherwise.
+   */
+  constexpr bool empty () const
+  {
+    return N == 0;
+  }
+
+  /**
+   * This method looks for a key.
+   * @param key
+   * @return pointer to the value of the key, or nullptr if the key is not
+   * in the map.
+   */
+  constexpr const ValueT *find (const KeyT &key) const
+  {
+    if constexpr (N == 0)
+    {
+      return nullptr;
+    }
+    else
+    {
+      const Slot &slot = slots_[index_of (static_hash<KeyT>::hash (key))];
+      return slot.first == key ? &slot.second : nullptr;
+    }
+  }
+
+  /**
+   * This method check if a key is in the map.
+   * @param key
+   * @return true if the key is in the map, false otherwise.
+   */
+  constexpr bool contains_key (const KeyT &key) const
+  {
+    return find (key) != nullptr;
+  }
+
+  /**
+   * This method returns the value of a key.
+   * @param key
+   * @return if the key is in the map, return the value of the key,
+   * otherwise, throw an exception.
+   */
+  constexpr const ValueT &at (const KeyT &key) const
+  {
+    const ValueT *value = find (key);
+    if (value == nullptr)
+    {
+      throw std::out_of_range (MESSAGE_KEY_NOT_FOUND);
+    }
+    return *value;
+  }
+
+ private:
+  /**
+   * A slot of the table. It is not a std::pair, whose assignment is not
+   * constexpr before C++20.
+   */
+  struct Slot
+  {
+    KeyT first {};
+    ValueT second {};
+  };
+
+  std::array<Slot, Capacity> slots_ {};
+  uint64_t seed_ = 1;
+
+  /**
+   * @return the number of bits of a slot index.
+   */
+  static constexpr int index_bits ()
+  {
+    int bits = 0;
+    while (((size_t) 1 << bits) < Capacity)
+    {
+      bits++;
+    }
+    return bits;
+  }
+
+  /**
+   * @param hash the hash of a key.
+   * @param seed the multiplier, odd.
+   * @return the slot of the key.
+   */
+  static constexpr size_t index_of (uint64_t hash, uint64_t seed)
+  {
+    return (size_t) ((hash * seed) >> (64 - index_bits ()));
+  }
+
+  /**
+   * @param hash the hash of a key.
+   * @return the slot of the key.
+   */
+  constexpr size_t index_of (uint64_t hash) const
+  {
+    return index_of (hash, seed_);
+  }
+
+  /**
+   * This function tries the multipliers of a splitmix64 sequence until one
+   * sends all the keys to different slots.
+   * @param items the items.
+   * @param hashes the hashes of their keys.
+   * @return the multiplier.
+   */
+  static constexpr uint64_t find_seed (const Pair (&items)[N],
+                                       const std::array<uint64_t, N> &hashes)
+  {
+    // A slot is taken in the current try if its stamp is the try number.
+    std::array<uint32_t, Capacity> stamps {};
+    uint64_t state = 0;
+    for (uint32_t attempt = 1; attempt <= STATIC_HASH_MAP_MAX_SEEDS;
+         attempt++)
+    {
+      state += SPLITMIX_INCREMENT;
+      uint64_t seed = state;
+      seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+      seed = (seed ^ (seed >> 31)) | 1;
+      size_t placed = 0;
+      for (; placed < N; placed++)
+      {
+        size_t slot = index_of (hashes[placed], seed);
+        if (stamps[slot] == attempt)
+        {
+          break;
+        }
+        stamps[slot] = attempt;
+      }
+      if (placed == N)
+      {
+        return seed;
+      }
+      for (size_t i = 0; i < placed; i++)
+      {
+        if (hashes[i] == hashes[placed]
+            && items[i].first == items[placed].first)
+        {
+          throw std::invalid_argument (MESSAGE_STATIC_DUPLICATE_KEY);
+        }
+      }
+    }
+    throw std::invalid_argument (MESSAGE_STATIC_NO_SEED);
+  }
+};
+
+/**
+ * This function builds a StaticHashMap, with the number of items taken from
+ * the initializer, as in:
+ *   constexpr auto ids = make_static_hash_map<std::string_view, int> (
+ *       {{"get", 1}, {"set", 2}});
+ * @param items the items.
+ * @return the map.
+ */
+template<typename KeyT, typename ValueT, size_t N>
+constexpr StaticHashMap<KeyT, ValueT, N>
+make_static_hash_map (const std::pair<KeyT, ValueT> (&items)[N])
+{
+  return StaticHashMap<KeyT, ValueT, N> (items);
+}
+
+#endif //_STATICHASHMAP_HPP_
@@ -0,0 +1,760 @@
+#ifndef _SWISSHASHMAP_HPP_
+#define _SWISSHASHMAP_HPP_
+
+#include <vector>
+#include <stdexcept>
+#include <utility>
+#include <functional>
+#include <new>
+#include <cstdint>
+#include <cstring>
+#include "HashMap.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define GROUP_WIDTH 16
+#define SWISS_MAX_LOAD_FACTOR 0.875
+#define CTRL_EMPTY ((int8_t) -128)
+#define CTRL_DELETED ((int8_t) -2)
+#define FINGERPRINT_MASK 0x7f
+#define HASH_MIX_CONSTANT 0x9e3779b97f4a7c15ULL
+
+/**
+ * A group of GROUP_WIDTH control bytes. A control byte is CTRL_EMPTY,
+ * CTRL_DELETED, or the 7-bit fingerprint of the key that is stored in the
+ * matching slot. Every match method returns a bit mask in which bit i is set
+ * if the i-th control byte of the group matches.
+ * With SSE2 the whole group is compared in one instruction, otherwise the
+ * bytes are compared one by one.
+ */
+class CtrlGroup
+{
+ public:
+  /**
+   * Loads a group of control bytes.
+   * @param ctrl pointer to the first control byte of the group.
+   */
+  explicit CtrlGroup (const int8_t *ctrl)
+  {
+#if defined(__SSE2__)
+    bytes_ = _mm_loadu_si128 (reinterpret_cast<const __m128i *> (ctrl));
+#else
+    std::memcpy (bytes_, ctrl, GROUP_WIDTH);
+#endif
+  }
+
+  /**
+   * @param fingerprint 7-bit fingerprint of a key.
+   * @return mask of the slots whose fingerprint is the given one.
+   */
+  uint32_t match (int8_t fingerprint) const
+  {
+#if defined(__SSE2__)
+    return (uint32_t) _mm_movemask_epi8 (
+        _mm_cmpeq_epi8 (bytes_, _mm_set1_epi8 (fingerprint)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; ++i)
+    {
+      mask |= (uint32_t) (bytes_[i] == fingerprint) << i;
+    }
+    return mask;
+#endif
+  }
+
+  /**
+   * @return mask of the empty slots.
+   */
+  uint32_t match_empty () const
+  {
+    return match (CTRL_EMPTY);
+  }
+
+  /**
+   * @return mask of the slots that are empty or deleted, that is, the slots
+   * that do not hold an item.
+   */
+  uint32_t match_free () const
+  {
+#if defined(__SSE2__)
+    return (uint32_t) _mm_movemask_epi8 (bytes_);
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; ++i)
+    {
+      mask |= (uint32_t) (bytes_[i] < 0) << i;
+    }
+    return mask;
+#endif
+  }
+
+  /**
+   * @param mask a non-zero match mask.
+   * @return the index of the lowest slot in the mask.
+   */
+  static int lowest (uint32_t mask)
+  {
+#if defined(__GNUC__)
+    return __builtin_ctz (mask);
+#else
+    int index = 0;
+    while (!(mask & 1u))
+    {
+      mask >>= 1;
+      index++;
+    }
+    return index;
+#endif
+  }
+
+ private:
+#if defined(__SSE2__)
+  __m128i bytes_;
+#else
+  int8_t bytes_[GROUP_WIDTH];
+#endif
+};
+
+/**
+ * An open-addressing hash map in the style of a Swiss table. Beside the
+ * array of slots, it keeps a parallel array of one-byte controls that hold a
+ * 7-bit fingerprint of the hash of every stored key. A probe loads a whole
+ * group of GROUP_WIDTH controls, compares them to the fingerprint of the
+ * searched key at once, and compares full keys only on fingerprint hits.
+ * A lookup ends at the first group that has an empty slot, so a miss
+ * usually reads a single group of controls and no key at all.
+ * The public API is the same as the API of HashMap.
+ */
+template<typename KeyT, typename ValueT>
+class SwissHashMap
+{
+ protected:
+  class IteratorConst;
+
+ public:
+  typedef std::pair<KeyT, ValueT> Pair;
+  typedef IteratorConst Iterator;
+
+  /**
+   * Default constructor
+   */
+  SwissHashMap ()
+  {
+    size_ = INITIAL_INT;
+    capacity_ = DEFAULT_CAPACITY;
+    allocate (capacity_);
+  }
+
+  /**
+   * Constructor that takes two vectors of the same size and creates a hash
+   * map. For a key that appears more than once, the last value is kept.
+   * @param keys vector of keys
+   * @param values vector of values
+   */
+  SwissHashMap (const std::vector<KeyT> &keys,
+                const std::vector<ValueT> &values)
+  {
+    if (keys.size () != values.size ())
+    {
+      throw std::invalid_argument (MESSAGE_UNMATCHED_SIZE);
+    }
+    size_ = INITIAL_INT;
+    capacity_ = DEFAULT_CAPACITY;
+    allocate (capacity_);
+    for (unsigned long i = 0; i < keys.size (); ++i)
+    {
+      this->operator[] (keys[i]) = values[i];
+    }
+  }
+
+  /**
+   * Copy constructor
+   * @param other the other hash map.
+   */
+  SwissHashMap (const SwissHashMap &other)
+  {
+    size_ = INITIAL_INT;
+    capacity_ = other.capacity_;
+    allocate (capacity_);
+    for (int i = 0; i < capacity_; ++i)
+    {
+      if (other.ctrl_[i] >= 0)
+      {
+        new (&slots_[i]) Pair (other.slots_[i]);
+        ctrl_[i] = other.ctrl_[i];
+        size_++;
+      }
+    }
+  }
+
+  /**
+   * Destructor
+   */
+  virtual ~SwissHashMap ()
+  {
+    release ();
+  }
+
+  /**
+   * This method returns the size of the hash map.
+   * @return size of the hash map.
+   */
+  int size () const
+  {
+    return size_;
+  }
+
+  /**
+   * This method returns the capacity (the number of slots) of the hash map.
+   * @return capacity of the hash map.
+   */
+  int capacity () const
+  {
+    return capacity_;
+  }
+
+  /**
+   * This method check if the hash map is empty.
+   * @return true if the hash map is empty, false otherwise.
+   */
+  bool empty () const
+  {
+    return size_ == INITIAL_INT;
+  }
+
+  /**
+   * This method returns the load factor of the hash map.
+   * @return load factor of the hash map.
+   */
+  double get_load_factor () const
+  {
+    return (double) size_ / capacity_;
+  }
+
+  /**
+   * This method insert a key-value pair into the hash map.
+   * @param key
+   * @param value
+   * @return true if the key-value pair is inserted, false if the key is
+   * already in the hash map.
+   */
+  bool insert (const KeyT &key, const ValueT &value)
+  {
+    size_t hash = mix (key);
+    if (find_slot (key, hash) != NOT_FOUND)
+    {
+      return false;
+    }
+    place (Pair (key, value), hash);
+    return true;
+  }
+
+  /**
+   * This method check if a key is in the hash map.
+   * @param key
+   * @return true if the key is in the hash map, false otherwise.
+   */
+  bool contains_key (const KeyT &key) const
+  {
+    return find_slot (key, mix (key)) != NOT_FOUND;
+  }
+
+  /**
+   * This method returns the value of a key.
+   * @param key
+   * @return if the key is in the hash map, return the value of the key,
+   * otherwise, throw an exception.
+   */
+  ValueT &at (const KeyT &key)
+  {
+    int slot = find_slot (key, mix (key));
+    if (slot == NOT_FOUND)
+    {
+      throw std::out_of_range (MESSAGE_KEY_NOT_FOUND);
+    }
+    return slots_[slot].second;
+  }
+
+  /**
+   * This method returns the value of a key. This method is const.
+   * @param key
+   * @return if the key is in the hash map, return the value of the key,
+   * otherwise, throw an exception.
+   */
+  const ValueT &at (const KeyT &key) const
+  {
+    int slot = find_slot (key, mix (key));
+    if (slot == NOT_FOUND)
+    {
+      throw std::out_of_range (MESSAGE_KEY_NOT_FOUND);
+    }
+    return slots_[slot].second;
+  }
+
+  /**
+   * This method erase a key-value pair from the hash map. If the group of
+   * the erased slot still has an empty slot, no probe has ever passed over
+   * this group, and the slot becomes empty. Otherwise it is marked as
+   * deleted, so that the probes that pass over it keep going.
+   * @param key
+   * @return if the key is in the hash map, erase the key-value pair and
+   * return true, otherwise, return false.
+   */
+  virtual bool erase (const KeyT &key)
+  {
+    int slot = find_slot (key, mix (key));
+    if (slot == NOT_FOUND)
+    {
+      return false;
+    }
+    slots_[slot].~Pair ();
+    int group_start = slot & ~(GROUP_WIDTH - 1);
+    if (CtrlGroup (ctrl_ + group_start).match_empty ())
+    {
+      ctrl_[slot] = CTRL_EMPTY;
+    }
+    else
+    {
+      ctrl_[slot] = CTRL_DELETED;
+      deleted_++;
+    }
+    size_--;
+    if (capacity_ > DEFAULT_CAPACITY
+        && get_load_factor () < MIN_LOAD_FACTOR)
+    {
+      rehash (capacity_ / RESIZE_FACTOR);
+    }
+    return true;
+  }
+
+  /**
+   * This method removes all the items from the hash map. The capacity is
+   * not changed.
+   */
+  void clear ()
+  {
+    for (int i = 0; i < capacity_; ++i)
+    {
+      if (ctrl_[i] >= 0)
+      {
+        slots_[i].~Pair ();
+      }
+      ctrl_[i] = CTRL_EMPTY;
+    }
+    size_ = INITIAL_INT;
+    deleted_ = INITIAL_INT;
+  }
+
+  /**
+   * This function swap the two hash maps.
+   * @param other the other hash map.
+   */
+  void swap (SwissHashMap &other)
+  {
+    std::swap (capacity_, other.capacity_);
+    std::swap (size_, other.size_);
+    std::swap (deleted_, other.deleted_);
+    std::swap (slots_, other.slots_);
+    std::swap (ctrl_, other.ctrl_);
+  }
+
+  /**
+   * This is assignment operator. It assigns the other hash map to this.
+   * @param other the other hash map.
+   * @return the reference to this hash map.
+   */
+  SwissHashMap &operator= (SwissHashMap other)
+  {
+    swap (other);
+    return *this;
+  }
+
+  /**
+   * This is operator[]. It returns the value of the key, and inserts a
+   * default value if the key is not in the hash map.
+   * @param key the key.
+   * @return the value of the key.
+   */
+  ValueT &operator[] (const KeyT &key)
+  {
+    size_t hash = mix (key);
+    int slot = find_slot (key, hash);
+    if (slot != NOT_FOUND)
+    {
+      return slots_[slot].second;
+    }
+    slot = place (Pair (key, ValueT ()), hash);
+    return slots_[slot].second;
+  }
+
+  /**
+   * This is operator==. It returns true if the two hash maps are equal,
+   * Otherwise, return false.
+   * @param other the other hash map.
+   * @return true if the two hash maps are equal, Otherwise, return false.
+   */
+  bool operator== (const SwissHashMap &other) const
+  {
+    if (size_ != other.size_)
+    {
+      return false;
+    }
+    for (auto it = cbegin (); it != cend (); ++it)
+    {
+      int slot = other.find_slot (it->first, mix (it->first));
+      if (slot == NOT_FOUND || other.slots_[slot].second != it->second)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * This is operator!=. It returns true if the two hash maps are not equal.
+   * @param other the other hash map.
+   * @return true if the two hash maps are not equal. Otherwise, return false.
+   */
+  bool operator!= (const SwissHashMap &other) const
+  {
+    return !(*this == other);
+  }
+
+ protected:
+  static const int NOT_FOUND = -1;
+
+  int capacity_;
+  int size_;
+  int deleted_;
+  Pair *slots_;
+  int8_t *ctrl_;
+
+  /**
+   * This is nested class for iterator. It walks the slots in order and
+   * skips the ones that do not hold an item.
+   */
+  class IteratorConst
+  {
+    friend class SwissHashMap;
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef const Pair value_type;
+    typedef const Pair &reference;
+    typedef const Pair *pointer;
+    typedef std::ptrdiff_t difference_type;
+
+    /**
+     * This is the default constructor.
+     */
+    explicit IteratorConst (const SwissHashMap &hash_map,
+                            bool end = false) : hash_map_ (hash_map)
+    {
+      slot_index_ = end ? hash_map_.capacity_ : INITIAL_INT;
+      skip_free ();
+    }
+
+    /**
+     * This is operator*. It returns the value of the iterator.
+     * @return
+     */
+    reference operator* () const
+    {
+      return hash_map_.slots_[slot_index_];
+    }
+
+    /**
+     * This is operator->. It returns the pointer of the iterator.
+     * @return
+     */
+    pointer operator-> () const
+    {
+      return &hash_map_.slots_[slot_index_];
+    }
+
+    /**
+     * This is operator++. It returns the next iterator.
+     * @return the next iterator.
+     */
+    IteratorConst &operator++ ()
+    {
+      slot_index_ += 1;
+      skip_free ();
+      return *this;
+    }
+
+    /**
+     * This is operator++. It returns the current iterator and then
+     * increment the iterator.
+     * @return the current iterator.
+     */
+    IteratorConst operator++ (int)
+    {
+      IteratorConst tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+
+    /**
+     * This is operator==. It returns true if the two iterators are equal.
+     * @param other
+     * @return true if the two iterators are equal. Otherwise, return false.
+     */
+    bool operator== (const IteratorConst &other) const
+    {
+      return slot_index_ == other.slot_index_
+             && &hash_map_ == &other.hash_map_;
+    }
+
+    /**
+     * This is operator!=. It returns true if the two iterators are not
+     * equal.
+     * @param other
+     * @return true if the two iterators are not equal. Otherwise, return
+     * false.
+     */
+    bool operator!= (const IteratorConst &other) const
+    {
+      return !(*this == other);
+    }
+
+   protected:
+    const SwissHashMap &hash_map_;
+    int slot_index_;
+
+    /**
+     * Moves the iterator forward to the next slot that holds an item.
+     */
+    void skip_free ()
+    {
+      while (slot_index_ < hash_map_.capacity_
+             && hash_map_.ctrl_[slot_index_] < 0)
+      {
+        slot_index_ += 1;
+      }
+    }
+  };
+
+ public:
+
+  /**
+   * This is cbegin method.
+   * @return It returns the iterator to the beginning.
+   */
+  Iterator cbegin () const
+  {
+    return IteratorConst (*this);
+  }
+
+  /**
+   * This is cend method.
+   * @return It returns the iterator to the end.
+   */
+  Iterator cend () const
+  {
+    return IteratorConst (*this, true);
+  }
+
+  /**
+   * This is begin method.
+   * @return It returns the iterator to the beginning.
+   */
+  Iterator begin () const
+  {
+    return IteratorConst (*this);
+  }
+
+  /**
+   * This is end method.
+   * @return It returns the iterator to the end.
+   */
+  Iterator end () const
+  {
+    return IteratorConst (*this, true);
+  }
+
+ private:
+
+  /**
+   * This function moves all the items into a new array of slots. The
+   * deleted markers are dropped on the way.
+   * @param new_capacity the number of slots in the new array, a power of two
+   * which is at least GROUP_WIDTH and large enough to hold all the items.
+   */
+  void rehash (int new_capacity)
+  {
+    Pair *old_slots = slots_;
+    int8_t *old_ctrl = ctrl_;
+    int old_capacity = capacity_;
+    allocate (new_capacity);
+    capacity_ = new_capacity;
+    size_ = INITIAL_INT;
+    for (int i = 0; i < old_capacity; ++i)
+    {
+      if (old_ctrl[i] >= 0)
+      {
+        size_t hash = mix (old_slots[i].first);
+        int slot = find_free_slot (hash);
+        new (&slots_[slot]) Pair (std::move (old_slots[i]));
+        ctrl_[slot] = fingerprint (hash);
+        size_++;
+        old_slots[i].~Pair ();
+      }
+    }
+    ::operator delete (old_slots);
+    delete[] old_ctrl;
+  }
+
+  /**
+   * This function allocates an empty array of slots and its controls. The
+   * items are constructed in place only when they are inserted.
+   * @param capacity the number of slots.
+   */
+  void allocate (int capacity)
+  {
+    slots_ = static_cast<Pair *> (::operator new (sizeof (Pair) * capacity));
+    ctrl_ = new int8_t[capacity];
+    std::memset (ctrl_, CTRL_EMPTY, capacity);
+    deleted_ = INITIAL_INT;
+  }
+
+  /**
+   * This function destroys all the items and frees the array of slots.
+   */
+  void release ()
+  {
+    for (int i = 0; i < capacity_; ++i)
+    {
+      if (ctrl_[i] >= 0)
+      {
+        slots_[i].~Pair ();
+      }
+    }
+    ::operator delete (slots_);
+    delete[] ctrl_;
+  }
+
+  /**
+   * This function hashes a key and spreads the bits of the hash, so that
+   * the group index and the fingerprint do not depend on the same bits.
+   * @param key
+   * @return the mixed hash of the key.
+   */
+  static size_t mix (const KeyT &key)
+  {
+    uint64_t hash = (uint64_t) std::hash<KeyT>{} (key) * HASH_MIX_CONSTANT;
+    return (size_t) (hash ^ (hash >> 32));
+  }
+
+  /**
+   * @param hash mixed hash of a key.
+   * @return the control byte of the key.
+   */
+  static int8_t fingerprint (size_t hash)
+  {
+    return (int8_t) (hash & FINGERPRINT_MASK);
+  }
+
+  /**
+   * @param hash mixed hash of a key.
+   * @return the index of the first slot of the first group in the probe
+   * sequence of the key.
+   */
+  int first_group (size_t hash) const
+  {
+    return (int) ((hash >> 7) & (size_t) (capacity_ - 1))
+           & ~(GROUP_WIDTH - 1);
+  }
+
+  /**
+   * This function looks for the slot of a key. Groups are probed in a
+   * triangular sequence, which visits every group once when the number of
+   * groups is a power of two.
+   * @param key
+   * @param hash mixed hash of the key.
+   * @return the index of the slot of the key, or NOT_FOUND.
+   */
+  int find_slot (const KeyT &key, size_t hash) const
+  {
+    int mask = capacity_ - 1;
+    int group = first_group (hash);
+    int8_t print = fingerprint (hash);
+    for (int step = GROUP_WIDTH; step <= capacity_ + GROUP_WIDTH;
+         step += GROUP_WIDTH)
+    {
+      CtrlGroup ctrl (ctrl_ + group);
+      for (uint32_t hits = ctrl.match (print); hits; hits &= hits - 1)
+      {
+        int slot = group + CtrlGroup::lowest (hits);
+        if (slots_[slot].first == key)
+        {
+          return slot;
+        }
+      }
+      if (ctrl.match_empty ())
+      {
+        return NOT_FOUND;
+      }
+      group = (group + step) & mask;
+    }
+    return NOT_FOUND;
+  }
+
+  /**
+   * This function finds the first slot in the probe sequence of a hash that
+   * does not hold an item. There must be at least one such slot.
+   * @param hash mixed hash of a key.
+   * @return the index of the slot.
+   */
+  int find_free_slot (size_t hash) const
+  {
+    int mask = capacity_ - 1;
+    int group = first_group (hash);
+    for (int step = GROUP_WIDTH;; step += GROUP_WIDTH)
+    {
+      uint32_t free_slots = CtrlGroup (ctrl_ + group).match_free ();
+      if (free_slots)
+      {
+        return group + CtrlGroup::lowest (free_slots);
+      }
+      group = (group + step) & mask;
+    }
+  }
+
+  /**
+   * This function places an item that is not in the hash map yet. If the
+   * items together with the deleted markers would pass the max load factor,
+   * the hash map is rehashed first: to a larger capacity if the items alone
+   * are above the load factor, otherwise to the same capacity, which only
+   * clears the deleted markers.
+   * @param item the item to place.
+   * @param hash mixed hash of the key of the item.
+   * @return the index of the slot in which the item was placed.
+   */
+  int place (Pair &&item, size_t hash)
+  {
+    if (size_ + deleted_ + 1 > capacity_ * SWISS_MAX_LOAD_FACTOR)
+    {
+      if (size_ + 1 > capacity_ * SWISS_MAX_LOAD_FACTOR / RESIZE_FACTOR)
+      {
+        rehash (capacity_ * RESIZE_FACTOR);
+      }
+      else
+      {
+        rehash (capacity_);
+      }
+    }
+    int slot = find_free_slot (hash);
+    if (ctrl_[slot] == CTRL_DELETED)
+    {
+      deleted_--;
+    }
+    new (&slots_[slot]) Pair (std::move (item));
+    ctrl_[slot] = fingerprint (hash);
+    size_++;
+    return slot;
+  }
+};
+
+#endif //_SWISSHASHMAP_HPP_
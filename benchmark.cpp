@@ -0,0 +1,1021 @@
+//
+// Benchmarks for the hash maps.
+// Usage: hashmap_benchmark [benchmark name] [number of keys]
+// Without arguments every benchmark runs with its default number of keys.
+//
+
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory_resource>
+#include "HashMap.hpp"
+#include "Dictionary.hpp"
+#include "ConcurrentHashMap.hpp"
+#include "ReadMostlyHashMap.hpp"
+#include "ShardedHashMap.hpp"
+#include "FrozenDictionary.hpp"
+#include "DelimitedLoader.hpp"
+#include "ArenaDictionary.hpp"
+#include "StaticHashMap.hpp"
+#include "Hashers.hpp"
+#include <malloc.h>
+
+using namespace std;
+
+#define RESIZE_BENCH_KEYS 10000000
+#define BULK_LOAD_BENCH_KEYS 5000000
+#define LATENCY_BENCH_KEYS 5000000
+#define CHURN_BENCH_KEYS 100000
+#define CHURN_BENCH_ROUNDS 50
+#define CONCURRENT_BENCH_KEYS 1000000
+#define CONCURRENT_BENCH_OPS 4000000
+#define READ_MOSTLY_BENCH_KEYS 100000
+#define READ_MOSTLY_BENCH_OPS 8000000
+#define READ_MOSTLY_WRITE_PERIOD_MS 10
+#define SCAN_BENCH_KEYS 2000000
+#define FROZEN_BENCH_KEYS 2000000
+#define FROZEN_BENCH_PATH "hashmap_benchmark.frz"
+#define SNAPSHOT_BENCH_KEYS 2000000
+#define SNAPSHOT_BENCH_PATH "hashmap_benchmark.snapshot"
+#define LOADER_BENCH_KEYS 2000000
+#define LOADER_BENCH_PATH "hashmap_benchmark.tsv"
+#define ARENA_BENCH_KEYS 2000000
+#define PMR_BENCH_REQUESTS 100000
+#define BATCH_BENCH_MAX_KEYS 100000000
+#define BATCH_BENCH_MIN_KEYS 1000000
+#define BATCH_BENCH_LOOKUPS 8000000
+#define BATCH_BENCH_REQUEST_KEYS 128
+#define UPDATE_BENCH_KEYS 5000000
+#define PERFECT_BENCH_KEYS 5000000
+#define STATIC_BENCH_LOOKUPS 20000000
+#define HASHERS_BENCH_KEYS 1000000
+#define HASHERS_BENCH_STRIDE 256
+#define PMR_BENCH_KEYS_PER_REQUEST 64
+#define PMR_BENCH_BUFFER_SIZE (1 << 16)
+
+typedef chrono::steady_clock bench_clock;
+
+// helpers
+/**
+ * @param start the time in which the measurement started.
+ * @return the number of seconds that passed since start.
+ */
+double seconds_since (bench_clock::time_point start)
+{
+  return chrono::duration<double> (bench_clock::now () - start).count ();
+}
+
+/**
+ * @param n number of keys.
+ * @return n distinct string keys, longer than the small string buffer so
+ * that hashing them is not trivial.
+ */
+vector<string> make_string_keys (int n)
+{
+  vector<string> keys;
+  keys.reserve (n);
+  for (int i = 0; i < n; i++)
+  {
+    keys.push_back ("dictionary_key_" + to_string (i));
+  }
+  return keys;
+}
+
+/**
+ * Prints percentiles of a set of latencies.
+ * @param name name of the measurement.
+ * @param nanos the latencies in nanoseconds. They are sorted in place.
+ */
+void print_percentiles (const string &name, vector<long> &nanos)
+{
+  sort (nanos.begin (), nanos.end ());
+  auto at = [&nanos] (double fraction)
+  {
+    return nanos[(size_t) (fraction * (double) (nanos.size () - 1))];
+  };
+  cout << name << ": p50 " << at (0.5) << " ns, p99 " << at (0.99)
+       << " ns, p99.9 " << at (0.999) << " ns, p99.99 " << at (0.9999)
+       << " ns, max " << nanos.back ()
+       << " ns" << endl;
+}
+
+/**
+ * A small and fast random number generator, one per thread.
+ * @param state the state of the generator.
+ * @return the next random number.
+ */
+uint64_t xorshift (uint64_t &state)
+{
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+/**
+ * Runs a function on a number of threads and measures them.
+ * @param threads number of threads.
+ * @param work the function, called with the index of the thread.
+ * @return the number of seconds until all the threads were done.
+ */
+template<class Work>
+double run_threads (int threads, Work work)
+{
+  vector<thread> pool;
+  auto start = bench_clock::now ();
+  for (int t = 0; t < threads; t++)
+  {
+    pool.emplace_back (work, t);
+  }
+  for (auto &worker: pool)
+  {
+    worker.join ();
+  }
+  return seconds_since (start);
+}
+
+/**
+ * @return the number of bytes the allocator handed out and did not get
+ * back yet.
+ */
+size_t allocated_bytes ()
+{
+  struct mallinfo2 info = mallinfo2 ();
+  return info.uordblks + info.hblkhd;
+}
+
+// benchmarks
+/**
+ * Measures a single grow and a single shrink of a map of n string keys, on
+ * one thread and on all the hardware threads.
+ * @param n number of keys.
+ */
+void bench_resize (int n)
+{
+  vector<string> keys = make_string_keys (n);
+  HashMap<string, string> map;
+  for (int i = 0; i < n; i++)
+  {
+    map.insert (keys[i], string ());
+  }
+  int capacity = map.capacity ();
+  for (int threads: {1, hardware_threads ()})
+  {
+    map.set_rehash_threads (threads);
+    auto start = bench_clock::now ();
+    map.resize (true);
+    double grow = seconds_since (start);
+    start = bench_clock::now ();
+    map.resize (false);
+    double shrink = seconds_since (start);
+    cout << "resize: " << n << " keys, " << threads << " threads, capacity "
+         << capacity << ", grow " << grow << " s, shrink " << shrink << " s"
+         << endl;
+  }
+}
+
+/**
+ * Measures building a Dictionary from vectors of n keys and values, on one
+ * thread and on all the hardware threads.
+ * @param n number of keys.
+ */
+void bench_bulk_load (int n)
+{
+  for (int threads: {1, hardware_threads ()})
+  {
+    vector<string> keys = make_string_keys (n);
+    vector<string> values = make_string_keys (n);
+    auto start = bench_clock::now ();
+    Dictionary dictionary (std::move (keys), std::move (values), threads);
+    double load = seconds_since (start);
+    cout << "bulk_load: " << n << " keys, " << threads << " threads, capacity "
+         << dictionary.capacity () << ", " << load << " s" << endl;
+  }
+}
+
+/**
+ * Measures the latency of every single insert of n string keys, with the
+ * table resized at once and with incremental resizing.
+ * @param n number of keys.
+ */
+void bench_insert_latency (int n)
+{
+  vector<string> keys = make_string_keys (n);
+  for (bool incremental: {false, true})
+  {
+    HashMap<string, string> map;
+    map.set_incremental_resize (incremental);
+    vector<long> nanos (n);
+    for (int i = 0; i < n; i++)
+    {
+      auto start = bench_clock::now ();
+      map.insert (keys[i], string ());
+      nanos[i] = chrono::duration_cast<chrono::nanoseconds> (
+          bench_clock::now () - start).count ();
+    }
+    print_percentiles (incremental ? "insert_latency (incremental)"
+                                   : "insert_latency (at once)", nanos);
+  }
+}
+
+/**
+ * Measures rounds of inserting n keys and erasing them all again, which
+ * crosses every resize threshold twice per round, under several resize
+ * policies.
+ * @param n number of keys.
+ */
+void bench_churn (int n)
+{
+  ResizePolicy classic, floor, lazy, delayed;
+  floor.min_capacity = 1 << 18;
+  lazy.shrink_on_erase = false;
+  delayed.shrink_delay = n;
+  pair<const char *, ResizePolicy> policies[] = {
+      {"classic", classic}, {"min_capacity 2^18", floor},
+      {"shrink_to_fit only", lazy}, {"shrink_delay n", delayed}};
+  for (auto &policy: policies)
+  {
+    HashMap<int, int> map;
+    map.set_resize_policy (policy.second);
+    auto start = bench_clock::now ();
+    for (int round = 0; round < CHURN_BENCH_ROUNDS; round++)
+    {
+      for (int i = 0; i < n; i++)
+      {
+        map.insert (i, i);
+      }
+      for (int i = 0; i < n; i++)
+      {
+        map.erase (i);
+      }
+    }
+    cout << "churn (" << policy.first << "): " << CHURN_BENCH_ROUNDS
+         << " rounds of " << n << " keys, " << seconds_since (start) << " s"
+         << endl;
+  }
+}
+
+/**
+ * Measures the throughput of a ConcurrentHashMap and a ShardedHashMap of n
+ * keys, against a HashMap behind one global mutex, with 1 to 64 threads
+ * and read/write mixes of 95/5 and 50/50. The total number of operations is
+ * fixed, and split between the threads.
+ * @param n number of keys.
+ */
+void bench_concurrent (int n)
+{
+  ConcurrentHashMap<int, int> striped;
+  ShardedHashMap<int, int> sharded;
+  HashMap<int, int> global;
+  mutex global_mutex;
+  for (int i = 0; i < n; i++)
+  {
+    striped.insert (i, i);
+    sharded.insert (i, i);
+    global.insert (i, i);
+  }
+  for (int write_percent: {5, 50})
+  {
+    for (int threads = 1; threads <= 64; threads *= 2)
+    {
+      int ops = CONCURRENT_BENCH_OPS / threads;
+      double striped_time = run_threads (threads, [&] (int t)
+      {
+        uint64_t state = t + 1;
+        int value;
+        for (int i = 0; i < ops; i++)
+        {
+          uint64_t random = xorshift (state);
+          int key = (int) (random % n);
+          if ((int) (random >> 32) % 100 < write_percent)
+          {
+            striped.insert_or_assign (key, i);
+          }
+          else
+          {
+            striped.find (key, value);
+          }
+        }
+      });
+      double sharded_time = run_threads (threads, [&] (int t)
+      {
+        uint64_t state = t + 1;
+        int value;
+        for (int i = 0; i < ops; i++)
+        {
+          uint64_t random = xorshift (state);
+          int key = (int) (random % n);
+          if ((int) (random >> 32) % 100 < write_percent)
+          {
+            sharded.insert_or_assign (key, i);
+          }
+          else
+          {
+            sharded.find (key, value);
+          }
+        }
+      });
+      double global_time = run_threads (threads, [&] (int t)
+      {
+        uint64_t state = t + 1;
+        for (int i = 0; i < ops; i++)
+        {
+          uint64_t random = xorshift (state);
+          int key = (int) (random % n);
+          lock_guard<mutex> lock (global_mutex);
+          if ((int) (random >> 32) % 100 < write_percent)
+          {
+            global.insert_or_assign (key, i);
+          }
+          else
+          {
+            global.find (key);
+          }
+        }
+      });
+      double total = (double) ops * threads / 1e6;
+      cout << "concurrent " << 100 - write_percent << "/" << write_percent
+           << ", " << threads << " threads: striped "
+           << total / striped_time << " Mops/s, sharded "
+           << total / sharded_time << " Mops/s, global mutex "
+           << total / global_time << " Mops/s" << endl;
+    }
+  }
+}
+
+/**
+ * Measures the lookup throughput of a ReadMostlyHashMap of n keys, against a
+ * ConcurrentHashMap, with 1 to 64 reader threads while one writer changes a
+ * key every READ_MOSTLY_WRITE_PERIOD_MS milliseconds. The number of lookups
+ * per thread is fixed, so that with linear scaling the time stays the same.
+ * @param n number of keys.
+ */
+void bench_read_mostly (int n)
+{
+  ReadMostlyHashMap<int, int> read_mostly;
+  ConcurrentHashMap<int, int> striped;
+  read_mostly.modify ([n] (HashMap<int, int> &items)
+                      {
+                        items.reserve (n);
+                        for (int i = 0; i < n; i++) items.insert (i, i);
+                      });
+  for (int i = 0; i < n; i++)
+  {
+    striped.insert (i, i);
+  }
+  int ops = READ_MOSTLY_BENCH_OPS / 8;
+  for (int threads = 1; threads <= 64; threads *= 2)
+  {
+    atomic<bool> done (false);
+    thread writer ([&] ()
+                   {
+                     for (int i = 0; !done; i++)
+                     {
+                       read_mostly.insert_or_assign (i % n, i);
+                       striped.insert_or_assign (i % n, i);
+                       this_thread::sleep_for (chrono::milliseconds (
+                           READ_MOSTLY_WRITE_PERIOD_MS));
+                     }
+                   });
+    double read_mostly_time = run_threads (threads, [&] (int t)
+    {
+      uint64_t state = t + 1;
+      int value;
+      for (int i = 0; i < ops; i++)
+      {
+        read_mostly.find ((int) (xorshift (state) % n), value);
+      }
+    });
+    double striped_time = run_threads (threads, [&] (int t)
+    {
+      uint64_t state = t + 1;
+      int value;
+      for (int i = 0; i < ops; i++)
+      {
+        striped.find ((int) (xorshift (state) % n), value);
+      }
+    });
+    done = true;
+    writer.join ();
+    double total = (double) ops * threads / 1e6;
+    cout << "read_mostly, " << threads << " threads: epoch "
+         << total / read_mostly_time << " Mops/s, striped "
+         << total / striped_time << " Mops/s" << endl;
+  }
+}
+
+/**
+ * Measures scans of a Dictionary of n keys: a sum over all the items with
+ * the iterators and with parallel_reduce, and erasing half of the items
+ * with erase(key) calls and with erase_if, on one thread and on all the
+ * hardware threads.
+ * @param n number of keys.
+ */
+void bench_scan (int n)
+{
+  Dictionary dictionary (make_string_keys (n), make_string_keys (n));
+  auto start = bench_clock::now ();
+  size_t total = 0;
+  for (const auto &item: dictionary)
+  {
+    total += item.second.size ();
+  }
+  double iterate = seconds_since (start);
+  start = bench_clock::now ();
+  size_t parallel_total = dictionary.parallel_reduce (
+      (size_t) 0, [] (const pair<string, string> &item)
+      { return item.second.size (); }, plus<size_t> ());
+  double reduce = seconds_since (start);
+  cout << "scan: " << n << " keys, iterators " << iterate
+       << " s, parallel_reduce " << reduce << " s"
+       << (total == parallel_total ? "" : " (MISMATCH)") << endl;
+
+  auto odd = [] (const pair<string, string> &item)
+  {
+    return (item.first.back () - '0') % 2 == 1;
+  };
+  {
+    Dictionary copy (dictionary);
+    vector<string> doomed;
+    for (const auto &item: copy)
+    {
+      if (odd (item)) doomed.push_back (item.first);
+    }
+    start = bench_clock::now ();
+    for (const auto &key: doomed)
+    {
+      copy.erase (key);
+    }
+    cout << "scan: erase(key) of " << doomed.size () << " keys "
+         << seconds_since (start) << " s, capacity " << copy.capacity ()
+         << endl;
+  }
+  for (int threads: {1, hardware_threads ()})
+  {
+    Dictionary copy (dictionary);
+    start = bench_clock::now ();
+    int erased = copy.erase_if (odd, threads);
+    cout << "scan: erase_if of " << erased << " keys, " << threads
+         << " threads " << seconds_since (start) << " s, capacity "
+         << copy.capacity () << endl;
+  }
+}
+
+/**
+ * Measures building a Dictionary of n keys from vectors, against opening a
+ * FrozenDictionary file of the same items, and the lookups of both.
+ * @param n number of keys.
+ */
+void bench_frozen (int n)
+{
+  vector<string> keys = make_string_keys (n);
+  auto start = bench_clock::now ();
+  Dictionary dictionary (keys, keys);
+  double build = seconds_since (start);
+  start = bench_clock::now ();
+  FrozenDictionary::write (dictionary, FROZEN_BENCH_PATH);
+  double write = seconds_since (start);
+  start = bench_clock::now ();
+  FrozenDictionary frozen (FROZEN_BENCH_PATH);
+  double open = seconds_since (start);
+  cout << "frozen: " << n << " keys, build Dictionary " << build
+       << " s, write " << write << " s, open " << open << " s" << endl;
+
+  size_t total = 0;
+  start = bench_clock::now ();
+  for (const auto &key: keys)
+  {
+    total += dictionary.at (key).size ();
+  }
+  double lookups = seconds_since (start);
+  start = bench_clock::now ();
+  for (const auto &key: keys)
+  {
+    total -= frozen.at (key).size ();
+  }
+  double frozen_lookups = seconds_since (start);
+  cout << "frozen: " << n << " lookups, Dictionary " << lookups
+       << " s, FrozenDictionary " << frozen_lookups << " s"
+       << (total == 0 ? "" : " (MISMATCH)") << endl;
+  remove (FROZEN_BENCH_PATH);
+}
+
+/**
+ * Measures saving and loading a Dictionary of n keys with save() and
+ * load(), against writing the items through the iterators and inserting
+ * them back one by one with operator[].
+ * @param n number of keys.
+ */
+void bench_snapshot (int n)
+{
+  vector<string> keys = make_string_keys (n);
+  Dictionary dictionary (keys, keys);
+
+  auto start = bench_clock::now ();
+  FILE *file = fopen (SNAPSHOT_BENCH_PATH, "w");
+  for (const auto &item: dictionary)
+  {
+    fprintf (file, "%s\t%s\n", item.first.c_str (), item.second.c_str ());
+  }
+  fclose (file);
+  double text_save = seconds_since (start);
+  start = bench_clock::now ();
+  Dictionary text_loaded;
+  file = fopen (SNAPSHOT_BENCH_PATH, "r");
+  char line[256];
+  while (fgets (line, sizeof (line), file) != nullptr)
+  {
+    char *tab = strchr (line, '\t');
+    string key (line, tab - line);
+    text_loaded[key] = string (tab + 1, strlen (tab + 1) - 1);
+  }
+  fclose (file);
+  double text_load = seconds_since (start);
+
+  start = bench_clock::now ();
+  dictionary.save (SNAPSHOT_BENCH_PATH);
+  double save = seconds_since (start);
+  start = bench_clock::now ();
+  Dictionary loaded;
+  loaded.load (SNAPSHOT_BENCH_PATH);
+  double load = seconds_since (start);
+  cout << "snapshot: " << n << " keys, iterators + operator[] save "
+       << text_save << " s, load " << text_load << " s; save() " << save
+       << " s, load() " << load << " s"
+       << (loaded == dictionary && text_loaded == dictionary
+           ? "" : " (MISMATCH)") << endl;
+  remove (SNAPSHOT_BENCH_PATH);
+}
+
+/**
+ * Measures loading a TSV file of n lines into a Dictionary: reading all the
+ * keys and values into vectors and passing them to the constructor, against
+ * load_delimited.
+ * @param n number of keys.
+ */
+void bench_loader (int n)
+{
+  vector<string> keys = make_string_keys (n);
+  FILE *file = fopen (LOADER_BENCH_PATH, "w");
+  for (const auto &key: keys)
+  {
+    fprintf (file, "%s\t%s\n", key.c_str (), key.c_str ());
+  }
+  fclose (file);
+  keys.clear ();
+  keys.shrink_to_fit ();
+
+  auto start = bench_clock::now ();
+  vector<string> file_keys, file_values;
+  file = fopen (LOADER_BENCH_PATH, "r");
+  char line[256];
+  while (fgets (line, sizeof (line), file) != nullptr)
+  {
+    char *tab = strchr (line, '\t');
+    file_keys.emplace_back (line, tab - line);
+    file_values.emplace_back (tab + 1, strlen (tab + 1) - 1);
+  }
+  fclose (file);
+  Dictionary vectors (std::move (file_keys), std::move (file_values));
+  double through_vectors = seconds_since (start);
+
+  Dictionary streamed;
+  LoadStats stats = load_delimited (streamed, LOADER_BENCH_PATH);
+  cout << "loader: " << n << " lines, " << stats.bytes / BYTES_PER_MEGABYTE
+       << " MB, vectors + constructor " << through_vectors
+       << " s, load_delimited " << stats.seconds << " s ("
+       << stats.megabytes_per_second () << " MB/s)"
+       << (streamed == vectors ? "" : " (MISMATCH)") << endl;
+  remove (LOADER_BENCH_PATH);
+}
+
+/**
+ * Measures the memory and the build time of a Dictionary and of an
+ * ArenaDictionary of n keys and values that are longer than the small
+ * string buffer, and the time of their lookups.
+ * @param n number of keys.
+ */
+void bench_arena (int n)
+{
+  vector<string> keys = make_string_keys (n);
+  size_t base = allocated_bytes ();
+  auto start = bench_clock::now ();
+  Dictionary dictionary;
+  for (const auto &key: keys)
+  {
+    dictionary.insert (key, key + "_value");
+  }
+  double build = seconds_since (start);
+  size_t dictionary_bytes = allocated_bytes () - base;
+  base = allocated_bytes ();
+  start = bench_clock::now ();
+  ArenaDictionary arena;
+  for (const auto &key: keys)
+  {
+    arena.insert (key, key + "_value");
+  }
+  double arena_build = seconds_since (start);
+  size_t arena_bytes = allocated_bytes () - base;
+  cout << "arena: " << n << " keys, Dictionary " << dictionary_bytes / 1e6
+       << " MB in " << build << " s, ArenaDictionary " << arena_bytes / 1e6
+       << " MB in " << arena_build << " s" << endl;
+
+  size_t total = 0;
+  start = bench_clock::now ();
+  for (const auto &key: keys)
+  {
+    total += dictionary.at (key).size ();
+  }
+  double lookups = seconds_since (start);
+  start = bench_clock::now ();
+  for (const auto &key: keys)
+  {
+    total -= arena.at (key).size ();
+  }
+  double arena_lookups = seconds_since (start);
+  for (int i = 0; i < n; i += 2)
+  {
+    arena.erase (keys[i]);
+  }
+  size_t dead = arena.dead_bytes ();
+  start = bench_clock::now ();
+  arena.compact ();
+  double compact = seconds_since (start);
+  cout << "arena: lookups, Dictionary " << lookups << " s, ArenaDictionary "
+       << arena_lookups << " s; compact of " << dead / 1e6 << " dead MB "
+       << compact << " s" << (total == 0 ? "" : " (MISMATCH)") << endl;
+}
+
+/**
+ * Measures per-request hash maps: n times, a hash map of a few keys is
+ * built, read and dropped, once with the default allocator and once as a
+ * pmr::HashMap on a monotonic buffer that is released in one shot.
+ * @param n number of requests.
+ */
+void bench_pmr (int n)
+{
+  long total = 0;
+  auto start = bench_clock::now ();
+  for (int request = 0; request < n; request++)
+  {
+    HashMap<int, int> map;
+    for (int i = 0; i < PMR_BENCH_KEYS_PER_REQUEST; i++)
+    {
+      map.insert (request + i, i);
+    }
+    total += map.at (request);
+  }
+  double heap = seconds_since (start);
+  vector<char> buffer (PMR_BENCH_BUFFER_SIZE);
+  start = bench_clock::now ();
+  for (int request = 0; request < n; request++)
+  {
+    std::pmr::monotonic_buffer_resource resource (buffer.data (),
+                                                  buffer.size ());
+    ::pmr::HashMap<int, int> map (&resource);
+    for (int i = 0; i < PMR_BENCH_KEYS_PER_REQUEST; i++)
+    {
+      map.insert (request + i, i);
+    }
+    total -= map.at (request);
+  }
+  double monotonic = seconds_since (start);
+  cout << "pmr: " << n << " requests of " << PMR_BENCH_KEYS_PER_REQUEST
+       << " keys, std::allocator " << heap << " s, monotonic buffer "
+       << monotonic << " s" << (total == 0 ? "" : " (MISMATCH)") << endl;
+}
+
+/**
+ * Measures requests of BATCH_BENCH_REQUEST_KEYS random keys that are
+ * resolved with a loop of at() calls and with find_batch(), in maps of 1M
+ * keys, then 10 times more, up to n keys.
+ * @param n the number of keys of the largest map.
+ */
+void bench_batch (int n)
+{
+  for (int keys = BATCH_BENCH_MIN_KEYS; keys <= n; keys *= 10)
+  {
+    HashMap<int, int> map;
+    map.reserve (keys);
+    for (int i = 0; i < keys; i++)
+    {
+      map.insert (i, i);
+    }
+    uint64_t state = 88172645463325252ULL;
+    vector<int> request (BATCH_BENCH_REQUEST_KEYS);
+    vector<const int *> out;
+    long total = 0;
+    double single = 0, batch = 0;
+    for (int done = 0; done < BATCH_BENCH_LOOKUPS;
+         done += BATCH_BENCH_REQUEST_KEYS)
+    {
+      for (auto &key: request)
+      {
+        key = (int) (xorshift (state) % keys);
+      }
+      auto start = bench_clock::now ();
+      for (int key: request)
+      {
+        total += map.at (key) - key;
+      }
+      single += seconds_since (start);
+      // Fresh keys, so that the batch does not find the lines at() loaded.
+      for (auto &key: request)
+      {
+        key = (int) (xorshift (state) % keys);
+        total += key;
+      }
+      start = bench_clock::now ();
+      map.find_batch (request, out);
+      for (const int *value: out)
+      {
+        total -= *value;
+      }
+      batch += seconds_since (start);
+    }
+    cout << "batch: " << keys << " keys, " << BATCH_BENCH_LOOKUPS
+         << " lookups in requests of " << BATCH_BENCH_REQUEST_KEYS
+         << ", at() " << single * 1e9 / BATCH_BENCH_LOOKUPS
+         << " ns/key, find_batch() " << batch * 1e9 / BATCH_BENCH_LOOKUPS
+         << " ns/key" << (total == 0 ? "" : " (MISMATCH)") << endl;
+  }
+}
+
+/**
+ * Measures a delta merge: a Dictionary of n keys is updated with n items,
+ * half of them new keys, once with a loop of insert_or_assign() calls and
+ * once with update() over move iterators.
+ * @param n number of keys.
+ */
+void bench_update (int n)
+{
+  vector<string> keys = make_string_keys (n + n / 2);
+  vector<pair<string, string>> delta;
+  delta.reserve (n);
+  for (int i = n / 2; i < n + n / 2; i++)
+  {
+    delta.emplace_back (keys[i], keys[i] + "_new_value");
+  }
+  keys.resize (n);
+  vector<string> values (keys.begin (), keys.end ());
+  Dictionary loop (keys, values);
+  Dictionary batch (keys, values);
+  vector<pair<string, string>> copy = delta;
+  auto start = bench_clock::now ();
+  for (auto &item: copy)
+  {
+    loop.insert_or_assign (std::move (item.first), std::move (item.second));
+  }
+  double single = seconds_since (start);
+  start = bench_clock::now ();
+  batch.update (make_move_iterator (delta.begin ()),
+                make_move_iterator (delta.end ()));
+  double update = seconds_since (start);
+  cout << "update: " << n << " items into " << n << " keys, "
+       << "insert_or_assign loop " << single << " s, update " << update
+       << " s" << (loop.size () == batch.size () ? "" : " (MISMATCH)")
+       << endl;
+}
+
+/**
+ * Measures building the perfect hash map of a Dictionary of n keys, on one
+ * thread and on all the hardware threads, its size, and its lookups in a
+ * random order against the lookups of the Dictionary.
+ * @param n number of keys.
+ */
+void bench_perfect (int n)
+{
+  vector<string> keys = make_string_keys (n);
+  Dictionary dictionary (keys, keys);
+  auto start = bench_clock::now ();
+  auto perfect = dictionary.freeze (1);
+  double single = seconds_since (start);
+  start = bench_clock::now ();
+  perfect = dictionary.freeze ();
+  double parallel = seconds_since (start);
+  cout << "perfect: " << n << " keys, freeze on 1 thread " << single
+       << " s, on " << hardware_threads () << " threads " << parallel
+       << " s, " << perfect.bits_per_key () << " bits/key" << endl;
+
+  uint64_t state = 88172645463325252ULL;
+  for (int i = n - 1; i > 0; i--)
+  {
+    swap (keys[i], keys[xorshift (state) % (i + 1)]);
+  }
+  size_t total = 0;
+  start = bench_clock::now ();
+  for (const auto &key: keys)
+  {
+    total += dictionary.at (key).size ();
+  }
+  double lookups = seconds_since (start);
+  start = bench_clock::now ();
+  for (const auto &key: keys)
+  {
+    total -= perfect.at (key).size ();
+  }
+  double perfect_lookups = seconds_since (start);
+  cout << "perfect: " << n << " random lookups, Dictionary " << lookups
+       << " s, PerfectHashMap " << perfect_lookups << " s"
+       << (total == 0 ? "" : " (MISMATCH)") << endl;
+}
+
+/**
+ * Measures n lookups of HTTP header names in a table of 24 of them, built
+ * at compile time as a StaticHashMap and at startup as a HashMap.
+ * @param n number of lookups.
+ */
+void bench_static (int n)
+{
+  static constexpr auto headers = make_static_hash_map<string_view, int> (
+      {{"accept", 0}, {"accept-encoding", 1}, {"accept-language", 2},
+       {"authorization", 3}, {"cache-control", 4}, {"connection", 5},
+       {"content-encoding", 6}, {"content-length", 7}, {"content-type", 8},
+       {"cookie", 9}, {"date", 10}, {"etag", 11}, {"expires", 12},
+       {"host", 13}, {"if-modified-since", 14}, {"if-none-match", 15},
+       {"last-modified", 16}, {"location", 17}, {"origin", 18},
+       {"referer", 19}, {"server", 20}, {"set-cookie", 21},
+       {"transfer-encoding", 22}, {"user-agent", 23}});
+  HashMap<string, int> map;
+  vector<string> names;
+  for (const char *name: {"accept", "accept-encoding", "accept-language",
+                          "authorization", "cache-control", "connection",
+                          "content-encoding", "content-length",
+                          "content-type", "cookie", "date", "etag",
+                          "expires", "host", "if-modified-since",
+                          "if-none-match", "last-modified", "location",
+                          "origin", "referer", "server", "set-cookie",
+                          "transfer-encoding", "user-agent"})
+  {
+    map.insert (name, (int) names.size ());
+    names.emplace_back (name);
+  }
+  vector<string_view> lookups (n);
+  uint64_t state = 88172645463325252ULL;
+  for (auto &lookup: lookups)
+  {
+    lookup = names[xorshift (state) % names.size ()];
+  }
+  long total = 0;
+  auto start = bench_clock::now ();
+  for (string_view name: lookups)
+  {
+    total += map.at (name);
+  }
+  double runtime = seconds_since (start);
+  start = bench_clock::now ();
+  for (string_view name: lookups)
+  {
+    total -= headers.at (name);
+  }
+  double compile_time = seconds_since (start);
+  cout << "static: " << n << " lookups in " << headers.size ()
+       << " keys, HashMap " << runtime * 1e9 / n << " ns, StaticHashMap "
+       << compile_time * 1e9 / n << " ns"
+       << (total == 0 ? "" : " (MISMATCH)") << endl;
+}
+
+/**
+ * Inserts keys into a map and looks them all up, and prints the times and
+ * the lengths of the chains that the lookups scanned.
+ * @param name the name of the hasher and the keys.
+ * @param keys the keys, all different.
+ */
+template<class Map, class Key>
+void measure_hasher (const char *name, const vector<Key> &keys)
+{
+  Map map;
+  auto start = bench_clock::now ();
+  for (const auto &key: keys)
+  {
+    map.insert (key, 1);
+  }
+  double insert = seconds_since (start);
+  long total = 0;
+  start = bench_clock::now ();
+  for (const auto &key: keys)
+  {
+    total += map.at (key);
+  }
+  double lookup = seconds_since (start);
+  long chains = 0;
+  int longest = 0;
+  for (const auto &key: keys)
+  {
+    int chain = map.bucket_size (key);
+    chains += chain;
+    longest = max (longest, chain);
+  }
+  cout << "hashers: " << name << ", insert " << insert << " s, lookup "
+       << lookup << " s, mean chain " << (double) chains / keys.size ()
+       << ", longest " << longest
+       << (total == (long) keys.size () ? "" : " (MISMATCH)") << endl;
+}
+
+/**
+ * Compares std::hash with the hashers of Hashers.hpp on n keys: integers
+ * in a row and with a stride of HASHERS_BENCH_STRIDE, and strings of a few
+ * lengths.
+ * @param n number of keys.
+ */
+void bench_hashers (int n)
+{
+  vector<long> sequential (n), strided (n);
+  for (int i = 0; i < n; i++)
+  {
+    sequential[i] = i;
+    strided[i] = (long) i * HASHERS_BENCH_STRIDE;
+  }
+  measure_hasher<HashMap<long, int>> ("std::hash, sequential integers",
+                                      sequential);
+  measure_hasher<HashMap<long, int, FibonacciHash>> (
+      "FibonacciHash, sequential integers", sequential);
+  measure_hasher<HashMap<long, int>> ("std::hash, strided integers",
+                                      strided);
+  measure_hasher<HashMap<long, int, FibonacciHash>> (
+      "FibonacciHash, strided integers", strided);
+  for (int length: {16, 64, 256})
+  {
+    vector<string> keys = make_string_keys (n);
+    for (auto &key: keys)
+    {
+      key.insert (0, length - min (length, (int) key.size ()), 'x');
+    }
+    string std_name = "std::hash, strings of " + to_string (length);
+    string fast_name = "FastStringHash, strings of " + to_string (length);
+    measure_hasher<HashMap<string, int>> (std_name.c_str (), keys);
+    measure_hasher<HashMap<string, int, FastStringHash>> (fast_name.c_str (),
+                                                          keys);
+    size_t hashes = 0;
+    auto start = bench_clock::now ();
+    for (const auto &key: keys)
+    {
+      hashes += std::hash<string>{} (key);
+    }
+    double std_hash = seconds_since (start);
+    start = bench_clock::now ();
+    for (const auto &key: keys)
+    {
+      hashes += FastStringHash {} (key);
+    }
+    double fast_hash = seconds_since (start);
+    cout << "hashers: hashing strings of " << length << ", std::hash "
+         << std_hash * 1e9 / n << " ns, FastStringHash "
+         << fast_hash * 1e9 / n << " ns" << (hashes == 1 ? " " : "")
+         << endl;
+  }
+}
+
+int main (int argc, char *argv[])
+{
+  struct benchmark
+  {
+    const char *name;
+    void (*run) (int);
+    int default_keys;
+  };
+
+  benchmark benchmarks[] = {
+      {"resize", bench_resize, RESIZE_BENCH_KEYS},
+      {"bulk_load", bench_bulk_load, BULK_LOAD_BENCH_KEYS},
+      {"insert_latency", bench_insert_latency, LATENCY_BENCH_KEYS},
+      {"churn", bench_churn, CHURN_BENCH_KEYS},
+      {"concurrent", bench_concurrent, CONCURRENT_BENCH_KEYS},
+      {"read_mostly", bench_read_mostly, READ_MOSTLY_BENCH_KEYS},
+      {"scan", bench_scan, SCAN_BENCH_KEYS},
+      {"frozen", bench_frozen, FROZEN_BENCH_KEYS},
+      {"snapshot", bench_snapshot, SNAPSHOT_BENCH_KEYS},
+      {"loader", bench_loader, LOADER_BENCH_KEYS},
+      {"arena", bench_arena, ARENA_BENCH_KEYS},
+      {"pmr", bench_pmr, PMR_BENCH_REQUESTS},
+      {"batch", bench_batch, BATCH_BENCH_MAX_KEYS},
+      {"update", bench_update, UPDATE_BENCH_KEYS},
+      {"perfect", bench_perfect, PERFECT_BENCH_KEYS},
+      {"static", bench_static, STATIC_BENCH_LOOKUPS},
+      {"hashers", bench_hashers, HASHERS_BENCH_KEYS},
+  };
+
+  int found = 0;
+  for (auto &bench: benchmarks)
+  {
+    if (argc > 1 && strcmp (argv[1], bench.name) != 0)
+    {
+      continue;
+    }
+    found++;
+    bench.run (argc > 2 ? atoi (argv[2]) : bench.default_keys);
+  }
+  if (!found)
+  {
+    cerr << "Unknown benchmark: " << argv[1] << endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
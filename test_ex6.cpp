@@ -17,8 +17,23 @@
 // includes
 #include "HashMap.hpp"
 #include "Dictionary.hpp"
+#include "RobinHoodHashMap.hpp"
+#include "SwissHashMap.hpp"
+#include "ConcurrentHashMap.hpp"
+#include "ReadMostlyHashMap.hpp"
+#include "ShardedHashMap.hpp"
+#include "FrozenDictionary.hpp"
+#include "DelimitedLoader.hpp"
+#include "ArenaDictionary.hpp"
+#include "PerfectHashMap.hpp"
+#include "StaticHashMap.hpp"
+#include "Hashers.hpp"
+#include <thread>
 #include <iostream>
 #include <utility>
+#include <string_view>
+#include <list>
+#include <map>
 #include "sstream"
 
 using namespace std;
@@ -1020,6 +1035,1110 @@ void test_const_correctness() {
   assert(h8.capacity()==32);
 }
 
+/**
+ * @tests:
+ * 0. insert, at, contains_key and erase on the Robin Hood map
+ * 1. erase keeps the keys that were shifted back reachable
+ * 2. grows and shrinks, iterators see every item
+ */
+void test_robin_hood_hash_map ()
+{
+  START_TEST;
+  RobinHoodHashMap<int, int> h1;
+  assert(h1.empty () && h1.capacity () == 16);
+  assert(h1.insert (1, 10));
+  assert(!h1.insert (1, 20));
+  assert(h1.at (1) == 10 && h1.contains_key (1));
+  assert(!h1.contains_key (17));
+  // keys 1, 17, 33 share a home slot, erasing the first shifts the others
+  assert(h1.insert (17, 170) && h1.insert (33, 330));
+  assert(h1.erase (1));
+  assert(!h1.erase (1));
+  assert(h1.at (17) == 170 && h1.at (33) == 330);
+  for (int i = 1000; i < 2000; i++) h1[i] = i * 2;
+  assert(h1.size () == 1002 && h1.capacity () == 2048);
+  int counter = 0;
+  for (auto it = h1.begin (); it != h1.end (); ++it) counter++;
+  assert(counter == 1002);
+  for (int i = 1000; i < 2000; i++) assert(h1.erase (i));
+  assert(h1.size () == 2 && h1.at (33) == 330);
+  assert(h1.capacity () == 16);
+  RobinHoodHashMap<string, string> h2 ({"a", "b", "a"}, {"A", "B", "C"});
+  assert(h2.size () == 2 && h2.at ("a") == "C");
+  RobinHoodHashMap<string, string> h3 (h2);
+  assert(h3 == h2);
+  h3.clear ();
+  assert(h3.empty () && h3 != h2);
+  bool thrown = false;
+  try
+  {
+    h3.at ("a");
+  }
+  catch (out_of_range &e)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+/**
+ * @tests:
+ * 0. insert, at, contains_key and erase on the Swiss table map
+ * 1. erased slots are reused and misses stay misses
+ * 2. grows and shrinks, iterators see every item
+ */
+void test_swiss_hash_map ()
+{
+  START_TEST;
+  SwissHashMap<int, int> h1;
+  assert(h1.empty () && h1.capacity () == 16);
+  assert(h1.insert (1, 10));
+  assert(!h1.insert (1, 20));
+  assert(h1.at (1) == 10 && h1.contains_key (1));
+  assert(!h1.contains_key (2));
+  for (int round = 0; round < 100; round++)
+  {
+    for (int i = 2; i < 14; i++) assert(h1.insert (i, i));
+    for (int i = 2; i < 14; i++) assert(h1.erase (i));
+  }
+  assert(h1.size () == 1 && h1.capacity () == 16);
+  for (int i = 1000; i < 3000; i++) h1[i] = i * 2;
+  assert(h1.size () == 2001 && h1.capacity () == 4096);
+  int counter = 0;
+  for (auto it = h1.begin (); it != h1.end (); ++it) counter++;
+  assert(counter == 2001);
+  for (int i = 1000; i < 3000; i++) assert(h1.at (i) == i * 2);
+  for (int i = 1000; i < 3000; i++) assert(h1.erase (i));
+  assert(!h1.erase (1000));
+  assert(h1.size () == 1 && h1.at (1) == 10);
+  SwissHashMap<string, string> h2 ({"a", "b", "a"}, {"A", "B", "C"});
+  assert(h2.size () == 2 && h2.at ("a") == "C");
+  SwissHashMap<string, string> h3 (h2);
+  assert(h3 == h2);
+  h3.clear ();
+  assert(h3.empty () && h3 != h2 && !h3.contains_key ("a"));
+}
+
+/**
+ * @tests:
+ * 0. find() returns an iterator to the item, or end() for a missing key
+ * 1. operator[] on a missing key resizes and still returns a valid value
+ */
+void test_find ()
+{
+  START_TEST;
+  HashMap<int, int> h1 ({1, 2, 3}, {10, 20, 30});
+  auto it = h1.find (2);
+  assert(it != h1.end () && it->first == 2 && it->second == 20);
+  assert(h1.find (4) == h1.end ());
+  int counter = 0;
+  for (; it != h1.end (); ++it) counter++;
+  assert(counter >= 1 && counter <= 3);
+  HashMap<int, int> h2;
+  for (int i = 0; i < 12; i++) h2[i] = i;
+  assert(h2.capacity () == 16);
+  h2[12] = 12; // Should resize before the value is returned
+  assert(h2.capacity () == 32 && h2.at (12) == 12);
+  const Dictionary d1 ({"a", "b"}, {"A", "B"});
+  assert(d1.find ("a")->second == "A");
+  assert(d1.find ("c") == d1.cend ());
+}
+
+/**
+ * @tests:
+ * 0. try_emplace and insert move the key and value only when inserting
+ * 1. insert_or_assign tells insert from assign
+ * 2. emplace builds the item from its arguments
+ */
+void test_emplace ()
+{
+  START_TEST;
+  HashMap<string, string> h1;
+  string key = "a long key that does not fit in a small string";
+  string value = "a long value that does not fit in a small string";
+  assert(h1.try_emplace (std::move (key), std::move (value)));
+  assert(key.empty () && value.empty ()); // Moved into the map
+  key = "a long key that does not fit in a small string";
+  value = "another value";
+  assert(!h1.try_emplace (std::move (key), std::move (value)));
+  assert(!key.empty () && value == "another value"); // Left untouched
+  assert(!h1.insert_or_assign (key, value));
+  assert(h1.at (key) == "another value");
+  assert(h1.insert_or_assign (string ("b"), string (3, 'B')));
+  assert(h1.at ("b") == "BBB");
+  assert(h1.emplace ("c", "C"));
+  assert(!h1.emplace (string ("c"), string ("D")));
+  assert(h1.at ("c") == "C" && h1.size () == 3);
+  assert(h1.try_emplace ("d", 4, 'D') && h1.at ("d") == "DDDD");
+  assert(h1.insert (string ("e"), string ("E")));
+  h1[string ("f")] = "F";
+  assert(h1.size () == 6 && h1["f"] == "F");
+}
+
+/**
+ * @tests:
+ * 0. string_view and const char* keys find the same items as std::string
+ * 1. Dictionary::erase with a string_view throws for a missing key
+ */
+void test_heterogeneous_lookup ()
+{
+  START_TEST;
+  Dictionary d1 ({"alpha", "beta", "gamma"}, {"A", "B", "C"});
+  const char *buffer = "alphabetagamma";
+  string_view alpha (buffer, 5), beta (buffer + 5, 4);
+  assert(d1.contains_key (alpha) && d1.contains_key (beta));
+  assert(!d1.contains_key (string_view (buffer, 4)));
+  assert(d1.at (beta) == "B");
+  assert(d1.find (alpha)->second == "A");
+  assert(d1.find (string_view (buffer)) == d1.end ());
+  const char *gamma = "gamma";
+  assert(d1.at (gamma) == "C");
+  assert(d1.bucket_index (gamma) == d1.bucket_index (string ("gamma")));
+  assert(d1.erase (alpha) && !d1.contains_key ("alpha"));
+  bool thrown = false;
+  try
+  {
+    d1.erase (alpha);
+  }
+  catch (InvalidKey &e)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+  HashMap<string, int> h1;
+  h1["key"] = 1;
+  assert(h1.erase (string_view ("key")) && h1.empty ());
+}
+
+/**
+ * @tests:
+ * 0. reserve() makes room for the items and never shrinks
+ * 1. rehash() sets the capacity, but never below the items
+ * 2. the vectors constructor moves the keys and values in
+ */
+void test_reserve_rehash ()
+{
+  START_TEST;
+  HashMap<int, int> h1;
+  h1.reserve (100);
+  assert(h1.capacity () == 256);
+  for (int i = 0; i < 100; i++) h1.insert (i, i);
+  assert(h1.capacity () == 256); // No resize while inserting
+  h1.reserve (10);
+  assert(h1.capacity () == 256);
+  h1.rehash (1024);
+  assert(h1.capacity () == 1024 && h1.size () == 100);
+  h1.rehash (1);
+  assert(h1.capacity () == 256); // 100 items need 256 buckets
+  for (int i = 0; i < 100; i++) assert(h1.at (i) == i);
+  assert(h1.get_load_factor () == 100.0 / 256);
+  vector<string> keys ({"a long key that does not fit in a small string"});
+  vector<string> values ({"a long value that does not fit in a small string"});
+  HashMap<string, string> h2 (std::move (keys), std::move (values));
+  assert(h2.size () == 1);
+  assert(h2.at ("a long key that does not fit in a small string")
+         == "a long value that does not fit in a small string");
+}
+
+/**
+ * @tests:
+ * 0. with incremental resizing, items are found while they are migrated
+ * 1. iterators see every item exactly once during a migration
+ * 2. copies and capacities match the map that resizes at once
+ */
+void test_incremental_resize ()
+{
+  START_TEST;
+  HashMap<int, int> h1, h2;
+  h1.set_incremental_resize (true);
+  bool seen_resizing = false;
+  for (int i = 0; i < 5000; i++)
+  {
+    assert(h1.insert (i, i * 10));
+    h2.insert (i, i * 10);
+    assert(h1.capacity () == h2.capacity () && h1.size () == h2.size ());
+    if (h1.resizing ())
+    {
+      seen_resizing = true;
+      assert(h1.contains_key (i / 2) && h1.at (i / 3) == (i / 3) * 10);
+      int counter = 0;
+      for (auto it = h1.begin (); it != h1.end (); ++it) counter++;
+      assert(counter == h1.size ());
+      HashMap<int, int> h3 (h1);
+      assert(!h3.resizing () && h3 == h1);
+    }
+  }
+  assert(seen_resizing && h1 == h2);
+  for (int i = 0; i < 5000; i += 2)
+  {
+    assert(h1.erase (i) && !h1.contains_key (i));
+    h2.erase (i);
+    assert(h1.capacity () == h2.capacity ());
+  }
+  for (int i = 1; i < 5000; i += 2) assert(h1.at (i) == i * 10);
+  h1.set_incremental_resize (false);
+  assert(!h1.resizing () && h1 == h2);
+}
+
+/**
+ * @tests:
+ * 0. a min capacity stops the collapse to capacity 1
+ * 1. without shrink on erase, only shrink_to_fit() shrinks
+ * 2. a shrink delay waits for erases in a row below the min load factor
+ * 3. invalid policies are rejected
+ */
+void test_resize_policy ()
+{
+  START_TEST;
+  HashMap<int, int> h1;
+  ResizePolicy floor;
+  floor.min_capacity = 16;
+  h1.set_resize_policy (floor);
+  assert(h1.insert (1, 1) && h1.erase (1));
+  assert(h1.capacity () == 16);
+  for (int i = 0; i < 100; i++) h1.insert (i, i);
+  for (int i = 0; i < 100; i++) h1.erase (i);
+  assert(h1.capacity () == 16 && h1.empty ());
+
+  HashMap<int, int> h2;
+  ResizePolicy lazy;
+  lazy.shrink_on_erase = false;
+  h2.set_resize_policy (lazy);
+  for (int i = 0; i < 100; i++) h2.insert (i, i);
+  for (int i = 0; i < 99; i++) h2.erase (i);
+  assert(h2.capacity () == 256 && h2.size () == 1);
+  h2.shrink_to_fit ();
+  assert(h2.capacity () == 2 && h2.at (99) == 99);
+
+  HashMap<int, int> h3;
+  ResizePolicy delayed;
+  delayed.shrink_delay = 2;
+  h3.set_resize_policy (delayed);
+  for (int i = 0; i < 8; i++) h3.insert (i, i); // capacity 16
+  for (int i = 0; i < 4; i++) h3.erase (i); // load 4/16, not below
+  h3.erase (4); // 1st erase below the min load factor
+  h3.insert (4, 4); // Back at the min load factor
+  h3.erase (4);
+  h3.erase (5);
+  assert(h3.capacity () == 16); // Only two erases in a row so far
+  h3.erase (6);
+  assert(h3.capacity () == 8 && h3.size () == 1);
+
+  bool thrown = false;
+  try
+  {
+    ResizePolicy bad;
+    bad.min_load_factor = 0.5; // Would shrink right after growing
+    h3.set_resize_policy (bad);
+  }
+  catch (invalid_argument &e)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+/**
+ * @tests:
+ * 0. threads that insert, update and erase disjoint keys see their own items
+ * 1. the map grows while other threads read from it
+ */
+void test_concurrent_hash_map ()
+{
+  START_TEST;
+  ConcurrentHashMap<int, int> h1;
+  vector<thread> threads;
+  vector<int> failures (8, 0);
+  for (int t = 0; t < 8; t++)
+  {
+    threads.emplace_back ([&h1, &failures, t] ()
+                          {
+                            for (int i = t; i < 8000; i += 8)
+                            {
+                              int value = 0;
+                              failures[t] += !h1.insert (i, i);
+                              failures[t] += !h1.find (i, value) || value != i;
+                              h1.update (i, [] (int &v) { v *= 2; });
+                              failures[t] += !h1.find (i, value)
+                                             || value != 2 * i;
+                              failures[t] += h1.insert_or_assign (i, -i);
+                              if (i % 2) failures[t] += !h1.erase (i);
+                            }
+                          });
+  }
+  for (auto &thread: threads) thread.join ();
+  for (int t = 0; t < 8; t++) assert(failures[t] == 0);
+  assert(h1.size () == 4000 && h1.capacity () == 8192);
+  int value = 0;
+  assert(h1.find (10, value) && value == -10 && !h1.contains_key (11));
+  h1.clear ();
+  assert(h1.empty () && !h1.contains_key (10));
+}
+
+void test_read_mostly_hash_map ()
+{
+  START_TEST;
+  ReadMostlyHashMap<int, string> h1;
+  atomic<bool> done (false);
+  vector<thread> readers;
+  vector<int> failures (4, 0);
+  for (int t = 0; t < 4; t++)
+  {
+    readers.emplace_back ([&h1, &done, &failures, t] ()
+                          {
+                            string value;
+                            while (!done)
+                            {
+                              for (int i = 0; i < 100; i++)
+                              {
+                                if (h1.find (i, value))
+                                {
+                                  failures[t] += value != to_string (i);
+                                }
+                              }
+                              failures[t] += h1.read (
+                                  [] (const HashMap<int, string> &items)
+                                  {
+                                    return items.size () > 100;
+                                  });
+                            }
+                          });
+  }
+  for (int i = 0; i < 100; i++) assert(h1.insert (i, to_string (i)));
+  assert(!h1.insert (0, "0") && !h1.insert_or_assign (0, "0"));
+  for (int i = 0; i < 100; i += 2) assert(h1.erase (i));
+  h1.modify ([] (HashMap<int, string> &items)
+             {
+               for (int i = 0; i < 100; i += 2) items.insert (i, to_string (i));
+             });
+  done = true;
+  for (auto &thread: readers) thread.join ();
+  for (int t = 0; t < 4; t++) assert(failures[t] == 0);
+  assert(h1.size () == 100 && h1.contains_key (42) && !h1.contains_key (100));
+  h1.assign (HashMap<int, string> ());
+  assert(h1.empty ());
+}
+
+void test_sharded_hash_map ()
+{
+  START_TEST;
+  ShardedHashMap<int, int> h1 (8);
+  vector<thread> threads;
+  vector<int> failures (8, 0);
+  for (int t = 0; t < 8; t++)
+  {
+    threads.emplace_back ([&h1, &failures, t] ()
+                          {
+                            for (int i = t; i < 8000; i += 8)
+                            {
+                              int value = 0;
+                              failures[t] += !h1.insert (i, i);
+                              h1.update (i, [] (int &v) { v *= 2; });
+                              failures[t] += !h1.find (i, value)
+                                             || value != 2 * i;
+                              failures[t] += h1.insert_or_assign (i, -i);
+                              if (i % 2) failures[t] += !h1.erase (i);
+                            }
+                          });
+  }
+  for (auto &thread: threads) thread.join ();
+  for (int t = 0; t < 8; t++) assert(failures[t] == 0);
+  assert(h1.size () == 4000 && h1.shards () == 8);
+  assert(h1.at (10) == -10 && !h1.contains_key (11));
+  long sum = 0;
+  h1.for_each ([&sum] (const pair<int, int> &item) { sum += item.second; });
+  assert(sum == -15996000);
+  h1.clear ();
+  assert(h1.empty ());
+
+  ShardedDictionary d1 ({"a", "b", "a"}, {"1", "2", "3"}, 4);
+  assert(d1.size () == 2 && d1.at ("a") == "3");
+  vector<pair<string, string>> items = {{"c", "4"}, {"a", "5"}, {"c", "6"}};
+  d1.update (items.begin (), items.end ());
+  assert(d1.size () == 3 && d1.at ("a") == "5" && d1.at ("c") == "6");
+  assert(d1.erase ("c") && !d1.contains_key ("c"));
+  bool thrown = false;
+  try
+  {
+    d1.erase ("c");
+  }
+  catch (InvalidKey &e)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+  thrown = false;
+  try
+  {
+    ShardedDictionary d2 (3);
+  }
+  catch (std::invalid_argument &e)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+void test_parallel_bulk_load ()
+{
+  START_TEST;
+  vector<int> keys, values;
+  for (int i = 0; i < 5000; i++)
+  {
+    keys.push_back ((i * 7919) % 3000);
+    values.push_back (i);
+  }
+  HashMap<int, int> h1 (keys, values, 1);
+  HashMap<int, int> h2 (keys, values, 4);
+  assert(h2.size () == 3000 && h2.capacity () == h1.capacity ());
+  assert(h1 == h2);
+  for (int i = 4990; i < 5000; i++)
+  {
+    assert(h2.at (keys[i]) == i && h2.bucket_index (keys[i])
+                                   == h1.bucket_index (keys[i]));
+  }
+  auto it1 = h1.begin ();
+  for (auto it2 = h2.begin (); it2 != h2.end (); ++it1, ++it2)
+  {
+    assert(*it1 == *it2);
+  }
+  Dictionary d1 ({"a", "b", "a"}, {"1", "2", "3"}, 3);
+  assert(d1.size () == 2 && d1.at ("a") == "3" && d1.capacity () == 16);
+  HashMap<int, int> h3 (vector<int> (), vector<int> (), 8);
+  assert(h3.empty () && h3.capacity () == 16);
+
+  bool thrown = false;
+  try
+  {
+    parallel_for (100, 4, [] (int worker, size_t, size_t)
+    {
+      if (worker == 2) throw std::runtime_error ("worker");
+    });
+  }
+  catch (std::runtime_error &e)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+void test_parallel_rehash ()
+{
+  START_TEST;
+  HashMap<int, int> h1, h2;
+  h2.set_rehash_threads (4);
+  for (int i = 0; i < 100000; i++)
+  {
+    h1.insert (i * 31, i);
+    h2.insert (i * 31, i);
+  }
+  assert(h2.capacity () == 262144 && h1 == h2);
+  h1.rehash (1 << 20);
+  h2.rehash (1 << 20);
+  assert(h2.capacity () == 1 << 20 && h1 == h2);
+  h1.shrink_to_fit ();
+  h2.shrink_to_fit ();
+  assert(h2.capacity () == 262144 && h1 == h2);
+  auto it1 = h1.begin ();
+  for (auto it2 = h2.begin (); it2 != h2.end (); ++it1, ++it2)
+  {
+    assert(*it1 == *it2);
+  }
+  for (int i = 0; i < 100000; i += 997)
+  {
+    assert(h2.at (i * 31) == i);
+  }
+}
+
+void test_erase_if_and_traversal ()
+{
+  START_TEST;
+  HashMap<int, int> h1;
+  for (int i = 0; i < 1000; i++) h1.insert (i, i);
+  long sum = h1.parallel_reduce (0L, [] (const pair<int, int> &item)
+  { return (long) item.second; }, std::plus<long> (), 4);
+  assert(sum == 499500);
+  atomic<int> visited (0);
+  h1.parallel_for_each ([&visited] (const pair<int, int> &)
+                        { visited++; }, 3);
+  assert(visited == 1000);
+
+  assert(h1.erase_if ([] (const pair<int, int> &item)
+                      { return item.first % 2; }) == 500);
+  assert(h1.size () == 500 && h1.capacity () == 1024);
+  assert(h1.contains_key (998) && !h1.contains_key (999));
+  assert(h1.erase_if ([] (const pair<int, int> &item)
+                      { return item.first >= 100; }, 4) == 450);
+  assert(h1.size () == 50 && h1.capacity () == 128);
+  assert(h1.erase_if ([] (const pair<int, int> &) { return false; }) == 0);
+  assert(h1.erase_if ([] (const pair<int, int> &) { return true; }) == 50);
+  assert(h1.empty () && h1.capacity () == 1);
+  h1.insert (5, 5);
+  assert(h1.at (5) == 5);
+
+  HashMap<int, int> h2;
+  ResizePolicy lazy;
+  lazy.shrink_on_erase = false;
+  h2.set_resize_policy (lazy);
+  for (int i = 0; i < 1000; i++) h2.insert (i, i);
+  h2.erase_if ([] (const pair<int, int> &item) { return item.first > 0; });
+  assert(h2.size () == 1 && h2.capacity () == 2048);
+  assert(h2.parallel_reduce (0, [] (const pair<int, int> &) { return 1; },
+                             std::plus<int> ()) == 1);
+}
+
+void test_frozen_dictionary ()
+{
+  START_TEST;
+  Dictionary d1;
+  for (int i = 0; i < 1000; i++)
+  {
+    d1.insert ("key" + to_string (i), to_string (i));
+  }
+  d1.insert ("", "empty key");
+  d1.insert ("empty value", "");
+  string path = "test_frozen_dictionary.frz";
+  FrozenDictionary::write (d1, path);
+  {
+    FrozenDictionary f1 (path);
+    assert(f1.size () == 1002 && !f1.empty ());
+    for (int i = 0; i < 1000; i++)
+    {
+      assert(f1.at ("key" + to_string (i)) == to_string (i));
+    }
+    assert(f1.at ("") == "empty key" && f1.at ("empty value").empty ());
+    string_view value;
+    assert(!f1.find ("key1000", value) && !f1.contains_key ("key"));
+    int items = 0;
+    f1.for_each ([&d1, &items] (string_view key, string_view value)
+                 {
+                   items += d1.at (string (key)) == value;
+                 });
+    assert(items == 1002);
+    bool thrown = false;
+    try
+    {
+      f1.at ("missing");
+    }
+    catch (std::out_of_range &e)
+    {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+  FrozenDictionary::write (Dictionary (), path);
+  FrozenDictionary f2 (path);
+  assert(f2.empty () && !f2.contains_key (""));
+  // A new file replaces the old one, which stays mapped as it was.
+  FrozenDictionary::write (d1, path);
+  assert(f2.empty () && !f2.contains_key ("key1"));
+  assert(FrozenDictionary (path).at ("key1") == "1");
+  // Slots that point past the blob are found when the file is opened.
+  FILE *file = fopen (path.c_str (), "r+b");
+  fseek (file, 64, SEEK_SET);
+  for (int i = 0; i < 256; i++) fputc (1, file);
+  fclose (file);
+  bool thrown = false;
+  try
+  {
+    FrozenDictionary f3 (path);
+  }
+  catch (std::runtime_error &e)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+  file = fopen (path.c_str (), "wb");
+  fputs ("not a frozen dictionary, but long enough for a header", file);
+  fclose (file);
+  thrown = false;
+  try
+  {
+    FrozenDictionary f4 (path);
+  }
+  catch (std::runtime_error &e)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+  remove (path.c_str ());
+}
+
+void test_save_load ()
+{
+  START_TEST;
+  string path = "test_save_load.snapshot";
+  HashMap<int, double> h1;
+  for (int i = 0; i < 1000; i++) h1.insert (i, i / 2.0);
+  h1.save (path);
+  HashMap<int, double> h2;
+  h2.insert (-1, -1);
+  h2.load (path);
+  assert(h2 == h1 && h2.capacity () == h1.capacity ());
+  assert(h2.at (999) == 499.5 && !h2.contains_key (-1));
+  h2.insert (1000, 500);
+  assert(h2.size () == 1001);
+
+  // A max load factor above 1 saves more items than buckets.
+  ResizePolicy dense;
+  dense.max_load_factor = 4;
+  HashMap<int, double> h3;
+  h3.set_resize_policy (dense);
+  for (int i = 0; i < 1000; i++) h3.insert (i, i);
+  assert(h3.size () > h3.capacity ());
+  h3.save (path);
+  HashMap<int, double> h4;
+  h4.set_resize_policy (dense);
+  h4.load (path);
+  assert(h4 == h3 && h4.capacity () == h3.capacity ());
+
+  Dictionary d1;
+  for (int i = 0; i < 1000; i++)
+  {
+    d1.insert (to_string (i), string (i % 50, 'x'));
+  }
+  d1.insert ("", "");
+  d1.save (path);
+  Dictionary d2;
+  d2.load (path);
+  assert(d2 == d1 && d2.at ("999") == string (49, 'x') && d2.at ("").empty ());
+  assert(d2.bucket_index ("17") == d1.bucket_index ("17"));
+
+  HashMap<string, string> empty;
+  empty.insert ("a", "b");
+  empty.erase ("a");
+  empty.save (path);
+  d2.load (path);
+  assert(d2.empty () && d2.capacity () == 1);
+
+  bool thrown = false;
+  try
+  {
+    h2.load (path);
+  }
+  catch (std::runtime_error &e)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+  thrown = false;
+  try
+  {
+    h2.load ("no_such_snapshot_file");
+  }
+  catch (std::runtime_error &e)
+  {
+    thrown = true;
+  }
+  assert(thrown && h2.size () == 1001);
+  remove (path.c_str ());
+}
+
+void test_load_delimited ()
+{
+  START_TEST;
+  string path = "test_load_delimited.tsv";
+  FILE *file = fopen (path.c_str (), "wb");
+  fputs ("a\t1\r\nb\t2\t3\n\nno delimiter\nkey with a long line\t", file);
+  fputs ("value that is longer than the block\na\t4\nlast\tline", file);
+  fclose (file);
+  for (size_t block_size: {(size_t) 4, (size_t) 16, (size_t) 1 << 20})
+  {
+    Dictionary d1;
+    LoadStats stats = load_delimited (d1, path, '\t', block_size);
+    assert(stats.lines == 5 && stats.malformed == 1 && stats.bytes == 95);
+    assert(d1.size () == 4 && d1.at ("a") == "4" && d1.at ("b") == "2\t3");
+    assert(d1.at ("key with a long line")
+           == "value that is longer than the block");
+    assert(d1.at ("last") == "line");
+  }
+  file = fopen (path.c_str (), "wb");
+  fputs ("x,1\ny,2\n", file);
+  fclose (file);
+  Dictionary d2;
+  load_delimited (d2, path, ',');
+  assert(d2.size () == 2 && d2.at ("y") == "2");
+  remove (path.c_str ());
+  bool thrown = false;
+  try
+  {
+    load_delimited (d2, path);
+  }
+  catch (std::runtime_error &e)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+void test_arena_dictionary ()
+{
+  START_TEST;
+  ArenaDictionary d1;
+  Dictionary d2;
+  for (int i = 0; i < 5000; i++)
+  {
+    string key = "key number " + to_string (i);
+    string value = string (i % 40, 'v') + to_string (i);
+    assert(d1.insert (key, value));
+    d2.insert (key, value);
+  }
+  assert(!d1.insert ("key number 7", "other"));
+  assert(d1.size () == 5000 && d1.capacity () == 8192);
+  for (const auto &item: d2) assert(d1.at (item.first) == item.second);
+  for (int i = 0; i < 5000; i += 2)
+  {
+    assert(d1.erase ("key number " + to_string (i)));
+  }
+  assert(!d1.insert_or_assign ("key number 1", "short"));
+  assert(!d1.insert_or_assign ("key number 3", string (100, 'l')));
+  assert(d1.insert_or_assign ("new key", "new value"));
+  // The new value is a view of the bytes it replaces.
+  assert(!d1.insert_or_assign ("new key", d1.at ("new key").substr (4)));
+  assert(d1.at ("new key") == "value");
+  assert(!d1.insert_or_assign ("new key", "new value"));
+  assert(d1.size () == 2501 && d1.dead_bytes () > 0);
+  bool thrown = false;
+  try
+  {
+    d1.erase ("key number 0");
+  }
+  catch (InvalidKey &e)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+  size_t before = d1.arena_bytes ();
+  d1.compact ();
+  assert(d1.dead_bytes () == 0 && d1.arena_bytes () <= before);
+  int checked = 0;
+  d1.for_each ([&] (string_view key, string_view value)
+               {
+                 if (key == "key number 1") checked += value == "short";
+                 else if (key == "key number 3")
+                   checked += value == string (100, 'l');
+                 else if (key == "new key") checked += value == "new value";
+                 else checked += d2.at (string (key)) == value;
+               });
+  assert(checked == 2501 && !d1.contains_key ("key number 4"));
+  string_view value;
+  assert(d1.find ("key number 4999", value)
+         && value == d2.at ("key number 4999"));
+  vector<pair<string, string>> items = {{"a", "1"}, {"a", "2"}};
+  d1.update (items.begin (), items.end ());
+  assert(d1.at ("a") == "2");
+  string big (3 << 20, 'b');
+  d1.insert ("big", big);
+  assert(d1.at ("big") == big);
+  d1.clear ();
+  assert(d1.empty () && d1.arena_bytes () == 0 && !d1.contains_key ("a"));
+}
+
+// An allocator that counts the bytes it holds.
+template<class T>
+struct CountingAllocator
+{
+  typedef T value_type;
+  long *bytes;
+
+  explicit CountingAllocator (long *counter) : bytes (counter)
+  {}
+
+  template<class U>
+  CountingAllocator (const CountingAllocator<U> &other) : bytes (other.bytes)
+  {}
+
+  T *allocate (size_t n)
+  {
+    *bytes += (long) (n * sizeof (T));
+    return std::allocator<T> ().allocate (n);
+  }
+
+  void deallocate (T *p, size_t n)
+  {
+    *bytes -= (long) (n * sizeof (T));
+    std::allocator<T> ().deallocate (p, n);
+  }
+
+  template<class U>
+  bool operator== (const CountingAllocator<U> &other) const
+  { return bytes == other.bytes; }
+
+  template<class U>
+  bool operator!= (const CountingAllocator<U> &other) const
+  { return bytes != other.bytes; }
+};
+
+void test_allocator ()
+{
+  START_TEST;
+  long bytes = 0;
+  {
+    typedef CountingAllocator<pair<const int, int>> Counting;
+    typedef HashMap<int, int, hash<int>, equal_to<int>, Counting> Counted;
+    Counted h1 ((Counting (&bytes)));
+    assert(bytes > 0);
+    for (int i = 0; i < 1000; i++) h1.insert (i, i * 2);
+    assert(h1.size () == 1000 && h1.at (999) == 1998);
+    auto h2 = h1;
+    assert(h2.get_allocator () == h1.get_allocator ());
+    for (int i = 0; i < 1000; i++) h1.erase (i);
+    h2.erase_if ([] (const pair<int, int> &item)
+                { return item.first % 2 == 0; });
+    assert(h1.empty () && h2.size () == 500 && h2.at (1) == 2);
+    h1 = h2;
+    h1.set_incremental_resize (true);
+    for (int i = 1000; i < 5000; i++) h1.insert (i, i);
+    assert(h1.size () == 4500 && h2.size () == 500);
+    Counted h3 ({1, 2}, {3, 4}, 1, Counting (&bytes));
+    assert(h3.at (2) == 4);
+  }
+  assert(bytes == 0);
+
+  char buffer[1 << 16];
+  std::pmr::monotonic_buffer_resource resource (buffer, sizeof (buffer),
+                                                std::pmr::null_memory_resource ());
+  ::pmr::HashMap<int, int> h4 (&resource);
+  for (int i = 0; i < 100; i++) h4.insert (i, -i);
+  ::pmr::HashMap<int, int> h5 (h4);
+  assert(h4.size () == 100 && h5.at (50) == -50);
+  assert(h4.get_allocator ().resource () == &resource);
+  assert(h5.get_allocator ().resource () != &resource);
+
+  // The resource is not thread-safe, so the threads asked for are not used.
+  std::pmr::monotonic_buffer_resource shared;
+  vector<int> keys, values;
+  for (int i = 0; i < 100000; i++)
+  {
+    keys.push_back (i);
+    values.push_back (i * 3);
+  }
+  ::pmr::HashMap<int, int> h6 (keys, values, 8, &shared);
+  assert(h6.size () == 100000 && h6.at (99999) == 299997);
+  h6.set_rehash_threads (8);
+  for (int i = 100000; i < 250000; i++) h6.insert (i, i * 3);
+  assert(h6.size () == 250000 && h6.at (0) == 0 && h6.at (249999) == 749997);
+}
+
+void test_find_batch ()
+{
+  START_TEST;
+  HashMap<int, int> h1;
+  h1.set_incremental_resize (true);
+  for (int i = 0; i < 1000; i++) h1.insert (i, i * 3);
+  vector<int> keys;
+  for (int i = -50; i < 1050; i++) keys.push_back (i);
+  vector<const int *> values;
+  vector<bool> found;
+  assert(h1.find_batch (keys, values) == 1000 && values.size () == 1100);
+  assert(h1.contains_batch (keys, found) == 1000 && found.size () == 1100);
+  for (size_t i = 0; i < keys.size (); i++)
+  {
+    bool in = keys[i] >= 0 && keys[i] < 1000;
+    assert(found[i] == in && (values[i] != nullptr) == in);
+    assert(!in || *values[i] == keys[i] * 3);
+  }
+  Dictionary d1;
+  d1.insert ("a", "1");
+  d1.insert ("b", "2");
+  vector<const string *> strings;
+  assert(d1.find_batch ({"b", "c", "a"}, strings) == 2);
+  assert(*strings[0] == "2" && strings[1] == nullptr && *strings[2] == "1");
+  assert(d1.contains_batch ({}, found) == 0 && found.empty ());
+}
+
+void test_update_range ()
+{
+  START_TEST;
+  Dictionary d1;
+  vector<pair<string, string>> items;
+  for (int i = 0; i < 10000; i++)
+  {
+    items.emplace_back ("key " + to_string (i),
+                        string (30, 'v') + to_string (i));
+  }
+  items.emplace_back ("key 0", "last");
+  d1.update (items.begin (), items.end ());
+  assert(d1.size () == 10000 && d1.capacity () == 16384);
+  assert(d1.at ("key 0") == "last"
+         && d1.at ("key 9999") == items[9999].second);
+  // Updates of existing keys do not leave the capacity larger.
+  d1.update (items.begin (), items.end ());
+  assert(d1.size () == 10000 && d1.capacity () == 16384);
+  vector<pair<string, string>> moved = {{"key 1", string (40, 'm')},
+                                        {"new", string (40, 'n')}};
+  d1.update (make_move_iterator (moved.begin ()),
+             make_move_iterator (moved.end ()));
+  assert(d1.at ("key 1") == string (40, 'm')
+         && d1.at ("new") == string (40, 'n'));
+  assert(moved[0].second.empty () && moved[1].first.empty ());
+  list<pair<const char *, const char *>> chars = {{"a", "1"}, {"b", "2"}};
+  d1.update (chars.begin (), chars.end ());
+  assert(d1.at ("a") == "1" && d1.size () == 10003);
+  HashMap<int, int> h1;
+  h1.set_incremental_resize (true);
+  for (int i = 0; i < 100; i++) h1.insert (i, i);
+  map<int, int> ordered = {{1, -1}, {500, 5}};
+  h1.update (ordered.begin (), ordered.end ());
+  assert(h1.size () == 101 && h1.at (1) == -1 && h1.at (500) == 5);
+  h1.update (ordered.end (), ordered.end ());
+  assert(h1.size () == 101);
+}
+
+void test_perfect_hash_map ()
+{
+  START_TEST;
+  Dictionary d1;
+  for (int i = 0; i < 1000; i++)
+  {
+    d1.insert ("key " + to_string (i), to_string (i * 7));
+  }
+  PerfectHashMap<string, string> p1 = d1.freeze (2);
+  assert(p1.size () == 1000 && !p1.empty ());
+  for (const auto &item: d1) assert(p1.at (item.first) == item.second);
+  assert(p1.contains_key (string_view ("key 999")) && !p1.contains_key ("key"));
+  assert(p1.at ("key 10") == "70" && p1.bits_per_key () < 4);
+  bool thrown = false;
+  try
+  {
+    p1.at ("key 1000");
+  }
+  catch (out_of_range &e)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+  int counted = 0;
+  for (const auto &item: p1) counted += d1.at (item.first) == item.second;
+  assert(counted == 1000);
+  HashMap<int, int> h1;
+  for (int i = 0; i < 250000; i++) h1.insert (i * 3, i);
+  PerfectHashMap<int, int> p2 (h1, 4);
+  int found = 0;
+  for (int i = 0; i < 750000; i++) found += p2.contains_key (i);
+  assert(found == 250000 && p2.at (749997) == 249999);
+  PerfectHashMap<int, int> p3 ((HashMap<int, int> ()));
+  assert(p3.empty () && !p3.contains_key (0) && p3.begin () == p3.end ());
+}
+
+void test_static_hash_map ()
+{
+  START_TEST;
+  constexpr auto commands = make_static_hash_map<string_view, int> (
+      {{"get", 1}, {"set", 2}, {"erase", 3}, {"", 4}, {"clear", 5}});
+  static_assert (commands.at ("set") == 2 && commands.contains_key (""));
+  static_assert (!commands.contains_key ("put") && commands.size () == 5);
+  assert(commands.capacity () == 16 && commands.at (string ("clear")) == 5);
+  assert(commands.find ("gets") == nullptr && *commands.find ("get") == 1);
+  bool thrown = false;
+  try
+  {
+    commands.at ("put");
+  }
+  catch (out_of_range &e)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+  constexpr StaticHashMap<int, char, 3, 64> digits ({{0, 'a'}, {7, 'b'},
+                                                     {-1, 'c'}});
+  static_assert (digits.at (-1) == 'c' && !digits.contains_key (1));
+  thrown = false;
+  try
+  {
+    make_static_hash_map<int, int> ({{1, 1}, {1, 2}});
+  }
+  catch (invalid_argument &e)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+// A hasher and a comparison of strings that ignore case.
+struct CaseInsensitiveHash
+{
+  size_t operator() (const string &key) const
+  {
+    string lower (key);
+    for (auto &c: lower) c = (char) tolower (c);
+    return FastStringHash {} (lower);
+  }
+};
+
+struct CaseInsensitiveEqual
+{
+  bool operator() (const string &a, const string &b) const
+  {
+    return a.size () == b.size ()
+           && equal (a.begin (), a.end (), b.begin (),
+                     [] (char x, char y)
+                     { return tolower (x) == tolower (y); });
+  }
+};
+
+struct SeededHash
+{
+  explicit SeededHash (size_t seed) : seed (seed)
+  {
+  }
+
+  size_t operator() (int key) const
+  {
+    return FibonacciHash {} ((size_t) key ^ seed);
+  }
+
+  size_t seed;
+};
+
+void test_hashers ()
+{
+  START_TEST;
+  HashMap<long, int, FibonacciHash> h1;
+  HashMap<long, int> h2;
+  for (int i = 0; i < 4096; i++)
+  {
+    h1.insert ((long) i << 16, i);
+    h2.insert ((long) i << 16, i);
+  }
+  int longest = 0;
+  for (int i = 0; i < 4096; i++)
+  {
+    assert(h1.at ((long) i << 16) == i);
+    longest = max (longest, h1.bucket_size ((long) i << 16));
+  }
+  assert(longest < 16 && h2.bucket_size (0) > 16);
+  assert(FastStringHash {} (string ("key")) == FastStringHash {} ("key"));
+  assert(FastStringHash {} (string (100, 'a'))
+         != FastStringHash {} (string (101, 'a')));
+  HashMap<string, string, FastStringHash> h3;
+  for (int i = 0; i < 1000; i++)
+  {
+    h3.insert (string (i % 70, 'k') + to_string (i), "v");
+  }
+  assert(h3.size () == 1000 && h3.contains_key (string_view ("kkk3")));
+  assert(h3.at ("0") == "v" && h3.erase ("kk2") && !h3.contains_key ("kk2"));
+  HashMap<string, int, CaseInsensitiveHash, CaseInsensitiveEqual> h4;
+  assert(h4.insert ("Content-Type", 1) && !h4.insert ("content-type", 2));
+  assert(h4.at ("CONTENT-TYPE") == 1 && h4.size () == 1);
+  assert(h4.key_eq () ("A", "a")
+         && h4.hash_function () ("A") == h4.hash_function () ("a"));
+  char buffer[4096];
+  std::pmr::monotonic_buffer_resource resource (buffer, sizeof (buffer));
+  ::pmr::HashMap<int, int, FibonacciHash> h5 (&resource);
+  h5.insert (1 << 20, 1);
+  assert(h5.at (1 << 20) == 1);
+  string path = "test_hashers.snapshot";
+  HashMap<int, int, SeededHash> h6 (SeededHash (12345), equal_to<int> ());
+  for (int i = 0; i < 10; i++) h6.insert (i, i * 7);
+  h6.save (path);
+  HashMap<int, int, SeededHash> h7 (SeededHash (12345), equal_to<int> ());
+  h7.load (path);
+  remove (path.c_str ());
+  assert(h7.hash_function ().seed == 12345 && h7.size () == 10);
+  for (int i = 0; i < 10; i++) assert(h7.at (i) == i * 7);
+}
+
 int main ()
 {
   typedef void (*test_func) ();
@@ -1053,7 +2172,31 @@ int main ()
       test_invalid_key_exception,
       test_capacity_edge_cases,
       test_special_key_types,
-      test_const_correctness
+      test_const_correctness,
+      test_robin_hood_hash_map,
+      test_swiss_hash_map,
+      test_find,
+      test_emplace,
+      test_heterogeneous_lookup,
+      test_reserve_rehash,
+      test_incremental_resize,
+      test_resize_policy,
+      test_concurrent_hash_map,
+      test_read_mostly_hash_map,
+      test_sharded_hash_map,
+      test_parallel_bulk_load,
+      test_parallel_rehash,
+      test_erase_if_and_traversal,
+      test_frozen_dictionary,
+      test_save_load,
+      test_load_delimited,
+      test_arena_dictionary,
+      test_allocator,
+      test_find_batch,
+      test_update_range,
+      test_perfect_hash_map,
+      test_static_hash_map,
+      test_hashers
   };
 
   int i = 0, passed = 0, counter = 0;